@@ -0,0 +1,109 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+/*
+whole-board move generation on 64-bit bitboards.
+
+squares use the same layout as BOARD_BIT_INDEX(row, col) in the game
+programs: bit 0 is (8, 8), bit 63 is (1, 1), and moving one column to
+the right is a shift by -1 while moving one row down is a shift by -8.
+
+instead of walking each direction one square at a time, every direction
+is filled at once over the whole board ("dumb7fill"). an Othello line
+can hold at most 6 opponent disks between the mover and the anchor, so
+six shift-and-mask steps per direction are always enough. shifting left
+(towards bit 63) by 1, 8, 7 and 9 moves left, up, up-right and up-left;
+shifting right by the same amounts gives the opposite four directions.
+*/
+
+typedef unsigned long long ull;
+
+/* every square except those in columns 1 and 8: stops horizontal wraps */
+#define BB_NOT_EDGE_COLS 0x7e7e7e7e7e7e7e7eULL
+
+#define BB_SQUARE_BIT(sq) (0x1ULL << (sq))
+#define BB_SQUARE_ROW(sq) (8 - ((sq) >> 3))
+#define BB_SQUARE_COL(sq) (8 - ((sq)&7))
+
+static inline int bb_popcount(ull b)
+{
+    return __builtin_popcountll(b);
+}
+
+/* index of the lowest set bit; b must not be 0 */
+static inline int bb_first_square(ull b)
+{
+    return __builtin_ctzll(b);
+}
+
+/* opponent disks reachable from `seed` along one direction, up to 6 deep */
+static inline ull bb_fill_left(ull seed, ull opp_masked, int shift)
+{
+    ull run = opp_masked & (seed << shift);
+    run |= opp_masked & (run << shift);
+    run |= opp_masked & (run << shift);
+    run |= opp_masked & (run << shift);
+    run |= opp_masked & (run << shift);
+    run |= opp_masked & (run << shift);
+    return run;
+}
+
+static inline ull bb_fill_right(ull seed, ull opp_masked, int shift)
+{
+    ull run = opp_masked & (seed >> shift);
+    run |= opp_masked & (run >> shift);
+    run |= opp_masked & (run >> shift);
+    run |= opp_masked & (run >> shift);
+    run |= opp_masked & (run >> shift);
+    run |= opp_masked & (run >> shift);
+    return run;
+}
+
+/*
+the empty squares just past runs of opponent disks that start next to an own
+disk, for the pair of opposite directions with the given shift
+*/
+static inline ull bb_moves_line(ull own, ull opp_masked, int shift)
+{
+    return (bb_fill_left(own, opp_masked, shift) << shift) |
+           (bb_fill_right(own, opp_masked, shift) >> shift);
+}
+
+/*
+return the set of empty squares where `own` can place a disk:
+for each direction, grow runs of opponent disks away from own disks and
+keep the empty square just past the end of each run.
+horizontal and diagonal runs use opponent disks off columns 1 and 8 only,
+so that no run wraps around a board edge.
+*/
+static inline ull bb_legal_moves(ull own, ull opp)
+{
+    ull inner = opp & BB_NOT_EDGE_COLS;
+    ull moves = bb_moves_line(own, inner, 1) | bb_moves_line(own, opp, 8) |
+                bb_moves_line(own, inner, 7) | bb_moves_line(own, inner, 9);
+    return moves & ~(own | opp);
+}
+
+/*
+the disks flipped along the pair of opposite directions with the given shift:
+a run flips only if it is capped by an own disk. the cap test is turned into
+an all-ones/all-zeros mask so no branch is taken.
+*/
+static inline ull bb_flips_line(ull move, ull own, ull opp_masked, int shift)
+{
+    ull left = bb_fill_left(move, opp_masked, shift);
+    ull right = bb_fill_right(move, opp_masked, shift);
+    return (left & (0ULL - (ull)(((left << shift) & own) != 0))) |
+           (right & (0ULL - (ull)(((right >> shift) & own) != 0)));
+}
+
+/* return the opponent disks flipped by placing an own disk on `sq` */
+static inline ull bb_flip_mask(int sq, ull own, ull opp)
+{
+    ull move = BB_SQUARE_BIT(sq);
+    ull inner = opp & BB_NOT_EDGE_COLS;
+    return bb_flips_line(move, own, inner, 1) | bb_flips_line(move, own, opp, 8) |
+           bb_flips_line(move, own, inner, 7) | bb_flips_line(move, own, inner, 9);
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef BITBOARD_LINES_H
+#define BITBOARD_LINES_H
+
+#include "bitboard.h"
+
+/*
+table-driven flip mask: a lookup per line instead of a fill per direction.
+
+every square lies on four lines (its row, its column and two diagonals). each
+line is gathered into an 8-bit index, one bit per square of the line, and two
+tables answer the rest:
+    - outflank[x][opp]: for a move on position x of a line and the opponent
+      disks on the 6 inner squares, the squares just past each run of opponent
+      disks next to x (the squares that would have to hold an own disk)
+    - flipped[x][cap]: for the own disks found there, the squares between x
+      and them, which are the disks the move flips
+rows are gathered with a shift, columns and diagonals with a multiply that
+packs one bit per row or column into the top byte. the tables and the diagonal
+masks are generated by constexpr code when the program is compiled.
+*/
+
+#define BB_LINE_GATHER 0x0101010101010101ULL
+#define BB_COLUMN_GATHER 0x0102040810204080ULL
+#define BB_COLUMN_SCATTER 0x0002040810204081ULL
+
+struct BbLineTables
+{
+    unsigned char outflank[8][64];
+    unsigned char flipped[8][256];
+    ull diagonal9[64]; /* squares on the shift-by-9 diagonal through sq */
+    ull diagonal7[64]; /* squares on the shift-by-7 diagonal through sq */
+
+    constexpr BbLineTables() : outflank(), flipped(), diagonal9(), diagonal7()
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            for (int inner = 0; inner < 64; inner++)
+            {
+                int opp = inner << 1;
+                int cap = 0;
+                int y = x + 1;
+                while (y < 7 && (opp & (1 << y)))
+                    y++;
+                if (y > x + 1 && y <= 7)
+                    cap |= 1 << y;
+                y = x - 1;
+                while (y > 0 && (opp & (1 << y)))
+                    y--;
+                if (y < x - 1 && y >= 0)
+                    cap |= 1 << y;
+                outflank[x][inner] = (unsigned char)cap;
+            }
+            for (int cap = 0; cap < 256; cap++)
+            {
+                int flips = 0;
+                for (int y = 0; y < 8; y++)
+                    if (cap & (1 << y))
+                        for (int z = (y < x ? y : x) + 1; z < (y < x ? x : y); z++)
+                            flips |= 1 << z;
+                flipped[x][cap] = (unsigned char)flips;
+            }
+        }
+        for (int sq = 0; sq < 64; sq++)
+            for (int other = 0; other < 64; other++)
+            {
+                if ((other >> 3) - (other & 7) == (sq >> 3) - (sq & 7))
+                    diagonal9[sq] |= 1ULL << other;
+                if ((other >> 3) + (other & 7) == (sq >> 3) + (sq & 7))
+                    diagonal7[sq] |= 1ULL << other;
+            }
+    }
+};
+
+static constexpr BbLineTables bb_line_tables = BbLineTables();
+
+// Flips along one line whose own and opponent disks are gathered into 8 bits, for a move on position x
+static inline int bb_line_flips(int x, int own8, int opp8)
+{
+    return bb_line_tables.flipped[x][bb_line_tables.outflank[x][(opp8 >> 1) & 63] & own8];
+}
+
+// Squares of `column` set in `b`: bit k of the result is bit column + 8k of the board
+static inline int bb_gather_column(ull b, int column)
+{
+    return (int)((((b >> column) & 0x0101010101010101ULL) * BB_COLUMN_GATHER) >> 56);
+}
+
+static inline ull bb_scatter_column(int flips, int column)
+{
+    return (((ull)flips * BB_COLUMN_SCATTER) & 0x0101010101010101ULL) << column;
+}
+
+// Squares of a diagonal set in `b`, one bit per column
+static inline int bb_gather_diagonal(ull b, ull diagonal)
+{
+    return (int)(((b & diagonal) * BB_LINE_GATHER) >> 56);
+}
+
+/* return the opponent disks flipped by placing an own disk on `sq`, same result as bb_flip_mask */
+static inline ull bb_flip_mask_lines(int sq, ull own, ull opp)
+{
+    int row = sq & 56, column = sq & 7;
+    ull flips = (ull)bb_line_flips(column, (int)((own >> row) & 0xff), (int)((opp >> row) & 0xff)) << row;
+    flips |= bb_scatter_column(bb_line_flips(sq >> 3, bb_gather_column(own, column), bb_gather_column(opp, column)), column);
+    ull diagonal = bb_line_tables.diagonal9[sq];
+    flips |= ((ull)bb_line_flips(column, bb_gather_diagonal(own, diagonal), bb_gather_diagonal(opp, diagonal)) * BB_LINE_GATHER) & diagonal;
+    diagonal = bb_line_tables.diagonal7[sq];
+    flips |= ((ull)bb_line_flips(column, bb_gather_diagonal(own, diagonal), bb_gather_diagonal(opp, diagonal)) * BB_LINE_GATHER) & diagonal;
+    return flips;
+}
+
+#endif
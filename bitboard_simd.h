@@ -0,0 +1,201 @@
+#ifndef BITBOARD_SIMD_H
+#define BITBOARD_SIMD_H
+
+#include <string.h>
+#include "bitboard.h"
+#include "bitboard_lines.h"
+
+/*
+vectorized versions of bb_legal_moves and bb_flip_mask.
+
+the eight directions are independent, so they are packed into SIMD lanes:
+    - AVX2 holds the shifts {1, 8, 7, 9} in four 64-bit lanes and runs the
+      fill once shifting left and once shifting right
+    - AVX-512 holds all eight directions in one register, shifting lanes
+      0-3 left and lanes 4-7 right
+the kernel is picked once at startup from what the CPU supports; the
+scalar kernel in bitboard.h is the fallback everywhere else. the "lines"
+kernel flips with the lookup tables of bitboard_lines.h instead.
+
+building with -DBB_DEFAULT_KERNEL='"name"' (make KERNEL=name) makes that
+kernel the default instead of the fastest one the CPU supports.
+*/
+
+typedef ull (*bb_legal_moves_fn)(ull own, ull opp);
+typedef ull (*bb_flip_mask_fn)(int sq, ull own, ull opp);
+
+typedef struct
+{
+    const char *name;
+    bb_legal_moves_fn legal_moves;
+    bb_flip_mask_fn flip_mask;
+} BitboardKernel;
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BB_HAVE_X86_SIMD 1
+
+__attribute__((target("avx2"))) static inline ull bb_or_lanes_avx2(__m256i v)
+{
+    __m128i x = _mm_or_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return (ull)_mm_cvtsi128_si64(_mm_or_si128(x, _mm_unpackhi_epi64(x, x)));
+}
+
+/* six masked shift steps in every lane, left (towards bit 63) or right */
+__attribute__((target("avx2"))) static inline __m256i bb_fill_left_avx2(__m256i seed, __m256i opp, __m256i shifts)
+{
+    __m256i run = _mm256_and_si256(opp, _mm256_sllv_epi64(seed, shifts));
+    for (int i = 0; i < 5; i++)
+        run = _mm256_or_si256(run, _mm256_and_si256(opp, _mm256_sllv_epi64(run, shifts)));
+    return run;
+}
+
+__attribute__((target("avx2"))) static inline __m256i bb_fill_right_avx2(__m256i seed, __m256i opp, __m256i shifts)
+{
+    __m256i run = _mm256_and_si256(opp, _mm256_srlv_epi64(seed, shifts));
+    for (int i = 0; i < 5; i++)
+        run = _mm256_or_si256(run, _mm256_and_si256(opp, _mm256_srlv_epi64(run, shifts)));
+    return run;
+}
+
+__attribute__((target("avx2"))) static ull bb_legal_moves_avx2(ull own, ull opp)
+{
+    const __m256i shifts = _mm256_set_epi64x(9, 7, 8, 1);
+    const __m256i masks = _mm256_set_epi64x(BB_NOT_EDGE_COLS, BB_NOT_EDGE_COLS, ~0ULL, BB_NOT_EDGE_COLS);
+    __m256i own_v = _mm256_set1_epi64x(own);
+    __m256i opp_v = _mm256_and_si256(_mm256_set1_epi64x(opp), masks);
+
+    __m256i left = _mm256_sllv_epi64(bb_fill_left_avx2(own_v, opp_v, shifts), shifts);
+    __m256i right = _mm256_srlv_epi64(bb_fill_right_avx2(own_v, opp_v, shifts), shifts);
+    return bb_or_lanes_avx2(_mm256_or_si256(left, right)) & ~(own | opp);
+}
+
+__attribute__((target("avx2"))) static ull bb_flip_mask_avx2(int sq, ull own, ull opp)
+{
+    const __m256i shifts = _mm256_set_epi64x(9, 7, 8, 1);
+    const __m256i masks = _mm256_set_epi64x(BB_NOT_EDGE_COLS, BB_NOT_EDGE_COLS, ~0ULL, BB_NOT_EDGE_COLS);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i move_v = _mm256_set1_epi64x(BB_SQUARE_BIT(sq));
+    __m256i own_v = _mm256_set1_epi64x(own);
+    __m256i opp_v = _mm256_and_si256(_mm256_set1_epi64x(opp), masks);
+
+    // keep a run only where the square past its end holds an own disk
+    __m256i left = bb_fill_left_avx2(move_v, opp_v, shifts);
+    __m256i left_open = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_sllv_epi64(left, shifts), own_v), zero);
+    __m256i right = bb_fill_right_avx2(move_v, opp_v, shifts);
+    __m256i right_open = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_srlv_epi64(right, shifts), own_v), zero);
+    return bb_or_lanes_avx2(_mm256_or_si256(_mm256_andnot_si256(left_open, left), _mm256_andnot_si256(right_open, right)));
+}
+
+/* lanes 0-3 shift left by {1, 8, 7, 9}, lanes 4-7 shift right by the same amounts */
+__attribute__((target("avx512f"))) static inline __m512i bb_shift_avx512(__m512i v, __m512i shifts)
+{
+    return _mm512_mask_blend_epi64(0xf0, _mm512_sllv_epi64(v, shifts), _mm512_srlv_epi64(v, shifts));
+}
+
+__attribute__((target("avx512f"))) static inline __m512i bb_fill_avx512(__m512i seed, __m512i opp, __m512i shifts)
+{
+    __m512i run = _mm512_and_si512(opp, bb_shift_avx512(seed, shifts));
+    for (int i = 0; i < 5; i++)
+        run = _mm512_or_si512(run, _mm512_and_si512(opp, bb_shift_avx512(run, shifts)));
+    return run;
+}
+
+#define BB_AVX512_SHIFTS _mm512_set_epi64(9, 7, 8, 1, 9, 7, 8, 1)
+#define BB_AVX512_MASKS                                                             \
+    _mm512_set_epi64(BB_NOT_EDGE_COLS, BB_NOT_EDGE_COLS, ~0ULL, BB_NOT_EDGE_COLS, \
+                     BB_NOT_EDGE_COLS, BB_NOT_EDGE_COLS, ~0ULL, BB_NOT_EDGE_COLS)
+
+__attribute__((target("avx512f"))) static ull bb_legal_moves_avx512(ull own, ull opp)
+{
+    const __m512i shifts = BB_AVX512_SHIFTS;
+    __m512i opp_v = _mm512_and_si512(_mm512_set1_epi64(opp), BB_AVX512_MASKS);
+    __m512i run = bb_fill_avx512(_mm512_set1_epi64(own), opp_v, shifts);
+    return (ull)_mm512_reduce_or_epi64(bb_shift_avx512(run, shifts)) & ~(own | opp);
+}
+
+__attribute__((target("avx512f"))) static ull bb_flip_mask_avx512(int sq, ull own, ull opp)
+{
+    const __m512i shifts = BB_AVX512_SHIFTS;
+    __m512i opp_v = _mm512_and_si512(_mm512_set1_epi64(opp), BB_AVX512_MASKS);
+    __m512i run = bb_fill_avx512(_mm512_set1_epi64(BB_SQUARE_BIT(sq)), opp_v, shifts);
+    __mmask8 capped = _mm512_test_epi64_mask(bb_shift_avx512(run, shifts), _mm512_set1_epi64(own));
+    return (ull)_mm512_reduce_or_epi64(_mm512_maskz_mov_epi64(capped, run));
+}
+#endif
+
+static ull bb_legal_moves_scalar(ull own, ull opp)
+{
+    return bb_legal_moves(own, opp);
+}
+
+static ull bb_flip_mask_scalar(int sq, ull own, ull opp)
+{
+    return bb_flip_mask(sq, own, opp);
+}
+
+/* all kernels, fastest first; "lines" is only used when asked for */
+static const BitboardKernel bb_kernels[] = {
+#ifdef BB_HAVE_X86_SIMD
+    {"avx512", bb_legal_moves_avx512, bb_flip_mask_avx512},
+    {"avx2", bb_legal_moves_avx2, bb_flip_mask_avx2},
+#endif
+    {"scalar", bb_legal_moves_scalar, bb_flip_mask_scalar},
+    {"lines", bb_legal_moves_scalar, bb_flip_mask_lines},
+};
+static const int bb_nkernels = sizeof(bb_kernels) / sizeof(BitboardKernel);
+
+/*
+the kernel used by the search, see bb_select_kernel. programs built on the engine
+library (engine.h defines ENGINE_LIBRARY) share the one of the library; a program
+of its own has its own.
+*/
+#ifdef ENGINE_LIBRARY
+extern BitboardKernel bb_kernel;
+#define BB_KERNEL_SHARED
+#else
+static BitboardKernel bb_kernel = {"scalar", bb_legal_moves_scalar, bb_flip_mask_scalar};
+#endif
+
+static inline bool bb_kernel_supported(const BitboardKernel *k)
+{
+#ifdef BB_HAVE_X86_SIMD
+    if (strcmp(k->name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512f");
+    if (strcmp(k->name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+#endif
+    return true;
+}
+
+#ifndef BB_DEFAULT_KERNEL
+#define BB_DEFAULT_KERNEL NULL
+#endif
+
+/*
+select the kernel by name, or BB_DEFAULT_KERNEL when name is NULL; the fastest
+one the CPU supports when neither names a supported kernel. returns the
+selected kernel.
+*/
+static inline const BitboardKernel *bb_select_kernel(const char *name)
+{
+    const BitboardKernel *fallback = NULL;
+    if (name == NULL)
+        name = BB_DEFAULT_KERNEL;
+    for (int i = 0; i < bb_nkernels; i++)
+    {
+        if (!bb_kernel_supported(&bb_kernels[i]))
+            continue;
+        if (fallback == NULL)
+            fallback = &bb_kernels[i];
+        if (name != NULL && strcmp(name, bb_kernels[i].name) == 0)
+        {
+            bb_kernel = bb_kernels[i];
+            return &bb_kernel;
+        }
+    }
+    bb_kernel = *fallback;
+    return &bb_kernel;
+}
+
+#endif
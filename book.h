@@ -0,0 +1,166 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <vector>
+#include "symmetry.h"
+
+/*
+opening book: the best moves of the positions near the start, searched ahead of
+time by the engine itself (othello -M).
+
+the file is a header (magic, number of entries) followed by fixed-size entries
+sorted by the Zobrist key of the canonical form of their position (symmetry.h;
+the keys come from a fixed seed, so they are the same in every run), with the best
+move as a square of the canonical form: the 8 images of a position share one
+entry. integers are in host byte order.
+at run time the file is memory-mapped read-only and probed in place with a binary
+search: loading parses nothing, and every process using the same book shares one
+copy of it in the page cache.
+
+a 64-bit key can in principle collide, so the caller checks that the book move
+is legal before playing it.
+*/
+
+typedef unsigned long long ull;
+
+#define BOOK_MAGIC "OTHBOOK2"
+
+typedef struct
+{
+    char magic[8];
+    ull nentries;
+} BookHeader;
+
+typedef struct
+{
+    ull key;
+    signed char score;    /* disk differential for the side to move */
+    unsigned char square; /* best move, square index as in bitboard.h */
+    unsigned char depth;  /* of the search that chose it */
+    unsigned char unused[5];
+} BookEntry;
+
+typedef struct
+{
+    const BookEntry *entries; /* NULL when no book is loaded */
+    ull nentries;
+    void *map;
+    size_t map_bytes;
+} OpeningBook;
+
+// Map the book `file`; return false (and leave `book` empty) if it cannot be read or is not a book
+static inline bool book_open(OpeningBook *book, const char *file)
+{
+    memset(book, 0, sizeof(*book));
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(BookHeader))
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    const BookHeader *header = (const BookHeader *)map;
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(header->magic)) != 0 ||
+        sizeof(BookHeader) + header->nentries * sizeof(BookEntry) != (size_t)st.st_size)
+    {
+        munmap(map, st.st_size);
+        return false;
+    }
+    book->entries = (const BookEntry *)(header + 1);
+    book->nentries = header->nentries;
+    book->map = map;
+    book->map_bytes = st.st_size;
+    return true;
+}
+
+static inline void book_close(OpeningBook *book)
+{
+    if (book->map)
+        munmap(book->map, book->map_bytes);
+    memset(book, 0, sizeof(*book));
+}
+
+// Look up the position with Zobrist `key`; return false if it is not in the book
+static inline bool book_probe(const OpeningBook *book, ull key, BookEntry *entry)
+{
+    ull low = 0, high = book->nentries;
+    while (low < high)
+    {
+        ull middle = low + (high - low) / 2;
+        if (book->entries[middle].key < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == book->nentries || book->entries[low].key != key)
+        return false;
+    *entry = book->entries[low];
+    return true;
+}
+
+// Look up the position of the disks `own` and `opp` with `color` to move; the move is returned as a square of this position
+static inline bool book_probe_position(const OpeningBook *book, ull own, ull opp, int color, BookEntry *entry)
+{
+    int symmetry;
+    if (book->nentries == 0 || !book_probe(book, symmetry_key(own, opp, color, &symmetry), entry))
+        return false;
+    if (entry->square < 64)
+        entry->square = (unsigned char)symmetry_inverse_square(entry->square, symmetry);
+    return true;
+}
+
+// The entry of the position of `own` and `opp` with `color` to move, for the best move `square` (64 for none)
+static inline BookEntry book_entry(ull own, ull opp, int color, int score, int square, int depth)
+{
+    int symmetry;
+    BookEntry entry = {};
+    entry.key = symmetry_key(own, opp, color, &symmetry);
+    entry.score = (signed char)score;
+    entry.square = (unsigned char)(square < 64 ? symmetry_square(square, symmetry) : 64);
+    entry.depth = (unsigned char)depth;
+    return entry;
+}
+
+// Order of the entries in the file: by key, the deepest first among equal keys
+static inline bool book_entry_before(const BookEntry &a, const BookEntry &b)
+{
+    return a.key != b.key ? a.key < b.key : a.depth > b.depth;
+}
+
+static inline bool book_same_key(const BookEntry &a, const BookEntry &b)
+{
+    return a.key == b.key;
+}
+
+/*
+write `entries` as the book `file`, sorted by key; of several entries for one key
+the deepest is kept. return false if the file cannot be written.
+*/
+static inline bool book_write(const char *file, std::vector<BookEntry> &entries)
+{
+    std::sort(entries.begin(), entries.end(), book_entry_before);
+    entries.erase(std::unique(entries.begin(), entries.end(), book_same_key), entries.end());
+
+    FILE *out = fopen(file, "wb");
+    if (out == NULL)
+        return false;
+    BookHeader header;
+    memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+    header.nentries = entries.size();
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   fwrite(entries.data(), sizeof(BookEntry), entries.size(), out) == entries.size();
+    return fclose(out) == 0 && written;
+}
+
+#endif
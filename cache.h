@@ -0,0 +1,135 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "book.h"
+
+/*
+persistent position cache: exact scores of deep searches and solved endgames,
+kept in a file across runs and shared by every process that uses it.
+
+the file has the layout of an opening book (book.h): a header and entries sorted
+by the Zobrist key of the canonical form of their position, each with the exact score, the best move and the depth of the
+search that found them; a position solved to the end of the game has depth
+CACHE_SOLVED, which answers a search of any depth. a run maps the file read-only
+and probes it with a binary search, and appends what it finds itself to a log in
+memory. between searches the log is merged into the file:
+    - the file is locked (a `.lock` file next to it) and mapped again, since
+      another process may have merged into it in the meantime
+    - the log and the file are merged, keeping the deepest result of a position
+    - past the size cap, the shallowest results are dropped
+    - the result is written to a temporary file and renamed over the old one,
+      so a process still mapping the old file keeps a consistent copy
+and the run goes on with the merged file.
+
+only nodes at least CACHE_MIN_DEPTH moves from the leaves are probed and logged:
+their searches cost far more than the binary search, and they are few enough that
+the log stays small.
+*/
+
+#define CACHE_MIN_DEPTH 6
+#define CACHE_SOLVED 64
+#define CACHE_DEFAULT_MEGABYTES 64
+
+/* the log is merged between searches once it holds this many results */
+#define CACHE_MERGE_ENTRIES 65536
+
+typedef struct
+{
+    const char *path; /* NULL when no cache is used */
+    size_t max_entries;
+    OpeningBook file; /* the entries of the file as last mapped */
+    std::vector<BookEntry> log;
+    std::atomic_flag log_lock;
+} PositionCache;
+
+// Use the cache file `path` (created at the first merge if missing), capped at `megabytes`
+static inline void cache_open(PositionCache *cache, const char *path, size_t megabytes)
+{
+    cache->path = path;
+    cache->max_entries = (megabytes << 20) / sizeof(BookEntry);
+    cache->log.clear();
+    cache->log_lock.clear();
+    // A missing file is an empty cache; anything else that is not a book is replaced at the first merge
+    book_open(&cache->file, path);
+}
+
+// Look up an exact result of the position of `own` and `opp` with `color` to move searched at least `depth` moves ahead
+static inline bool cache_probe(const PositionCache *cache, ull own, ull opp, int color, int depth, BookEntry *entry)
+{
+    return depth >= CACHE_MIN_DEPTH && book_probe_position(&cache->file, own, opp, color, entry) && entry->depth >= depth;
+}
+
+// Log the exact `score` and best move `square` of a search `depth` moves ahead; any worker may call it
+static inline void cache_add(PositionCache *cache, ull own, ull opp, int color, int depth, int score, int square)
+{
+    if (cache->path == NULL || depth < CACHE_MIN_DEPTH)
+        return;
+    BookEntry entry = book_entry(own, opp, color, score, square, depth < CACHE_SOLVED ? depth : CACHE_SOLVED);
+    while (cache->log_lock.test_and_set(std::memory_order_acquire))
+        ;
+    cache->log.push_back(entry);
+    cache->log_lock.clear(std::memory_order_release);
+}
+
+// Order for the size cap: the deepest results first
+static inline bool cache_entry_deeper(const BookEntry &a, const BookEntry &b)
+{
+    return a.depth > b.depth;
+}
+
+/*
+merge the log into the file (see above) and map the result. no search may run
+during the merge, since it unmaps the entries the searches probe. return false if
+the file cannot be written; the log is then kept for the next merge.
+*/
+static inline bool cache_merge(PositionCache *cache)
+{
+    if (cache->path == NULL || cache->log.empty())
+        return true;
+    std::string lock_path = std::string(cache->path) + ".lock";
+    std::string temp_path = std::string(cache->path) + ".tmp";
+    int lock = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (lock < 0)
+        return false;
+    flock(lock, LOCK_EX);
+
+    book_close(&cache->file);
+    book_open(&cache->file, cache->path);
+    std::vector<BookEntry> entries(cache->file.entries, cache->file.entries + cache->file.nentries);
+    entries.insert(entries.end(), cache->log.begin(), cache->log.end());
+    std::sort(entries.begin(), entries.end(), book_entry_before);
+    entries.erase(std::unique(entries.begin(), entries.end(), book_same_key), entries.end());
+    if (entries.size() > cache->max_entries)
+    {
+        std::nth_element(entries.begin(), entries.begin() + cache->max_entries, entries.end(), cache_entry_deeper);
+        entries.resize(cache->max_entries);
+    }
+
+    bool written = book_write(temp_path.c_str(), entries) && rename(temp_path.c_str(), cache->path) == 0;
+    if (written)
+    {
+        cache->log.clear();
+        book_close(&cache->file);
+        book_open(&cache->file, cache->path);
+    }
+    flock(lock, LOCK_UN);
+    close(lock);
+    return written;
+}
+
+// Between searches: merge the log once it has grown large
+static inline bool cache_checkpoint(PositionCache *cache)
+{
+    return cache->log.size() < CACHE_MERGE_ENTRIES || cache_merge(cache);
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "bitboard.h"
+
+/*
+exact endgame solver on bitboards.
+
+once every remaining move can be searched, the score of a position is the
+final disk difference (own - opponent, empty squares are not counted, the
+same as utility() in the game programs). the solver is a fail-soft negamax
+alpha-beta specialised for few empties:
+    - more than ENDGAME_FASTEST_FIRST_EMPTIES empties: moves that leave the
+      opponent the fewest replies go first ("fastest first")
+    - fewer empties: moves into quadrants with an odd number of empties go
+      first (parity: the side that moves last in a region usually gains)
+    - the last 4 empties are solved by hand-unrolled functions that work on
+      a short list of squares instead of generating moves
+a win/loss/draw answer is a search with the window (-1, 1) around a draw.
+*/
+
+/* the game programs switch to an exact solve at this many empties */
+#define ENDGAME_DEFAULT_EMPTIES 14
+
+#define ENDGAME_FASTEST_FIRST_EMPTIES 7
+#define ENDGAME_NO_SQUARE 64
+#define ENDGAME_INFINITY 100
+
+/* the four 4x4 quadrants of the board */
+static const ull endgame_quadrant_masks[4] = {
+    0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL, 0x0f0f0f0f00000000ULL, 0xf0f0f0f000000000ULL};
+
+static inline int endgame_quadrant(int sq)
+{
+    return ((sq >> 4) & 2) | ((sq >> 2) & 1);
+}
+
+// Bit q is set if quadrant q holds an odd number of empty squares
+static inline int endgame_parity(ull empty)
+{
+    int parity = 0;
+    for (int q = 0; q < 4; q++)
+        parity |= (bb_popcount(empty & endgame_quadrant_masks[q]) & 1) << q;
+    return parity;
+}
+
+static inline int endgame_final_score(ull own, ull opp)
+{
+    return bb_popcount(own) - bb_popcount(opp);
+}
+
+// Board after `own` plays on `sq`, flipping `flips`, seen from the opponent (who moves next)
+#define ENDGAME_PLAY(own, opp, sq, flips, next_own, next_opp) \
+    ull next_own = (opp) & ~(flips);                          \
+    ull next_opp = (own) | (flips) | BB_SQUARE_BIT(sq)
+
+/* one empty square: whoever can play it does, otherwise the game is over */
+static inline int endgame_solve_1(ull own, ull opp, int sq)
+{
+    int score = endgame_final_score(own, opp);
+    ull flips = bb_flip_mask(sq, own, opp);
+    if (flips)
+        return score + 2 * bb_popcount(flips) + 1;
+    flips = bb_flip_mask(sq, opp, own);
+    if (flips)
+        return score - 2 * bb_popcount(flips) - 1;
+    return score;
+}
+
+static int endgame_solve_2(ull own, ull opp, int alpha, int beta, int sq1, int sq2, bool passed)
+{
+    int best = -ENDGAME_INFINITY;
+    ull flips;
+    if ((flips = bb_flip_mask(sq1, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq1, flips, next_own, next_opp);
+        best = -endgame_solve_1(next_own, next_opp, sq2);
+        if (best >= beta)
+            return best;
+    }
+    if ((flips = bb_flip_mask(sq2, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq2, flips, next_own, next_opp);
+        int score = -endgame_solve_1(next_own, next_opp, sq1);
+        if (score > best)
+            best = score;
+    }
+    if (best == -ENDGAME_INFINITY)
+        best = passed ? endgame_final_score(own, opp) : -endgame_solve_2(opp, own, -beta, -alpha, sq1, sq2, true);
+    return best;
+}
+
+static int endgame_solve_3(ull own, ull opp, int alpha, int beta, int sq1, int sq2, int sq3, bool passed)
+{
+    int best = -ENDGAME_INFINITY;
+    ull flips;
+    if ((flips = bb_flip_mask(sq1, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq1, flips, next_own, next_opp);
+        best = -endgame_solve_2(next_own, next_opp, -beta, -alpha, sq2, sq3, false);
+        if (best >= beta)
+            return best;
+        if (best > alpha)
+            alpha = best;
+    }
+    if ((flips = bb_flip_mask(sq2, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq2, flips, next_own, next_opp);
+        int score = -endgame_solve_2(next_own, next_opp, -beta, -alpha, sq1, sq3, false);
+        if (score >= beta)
+            return score;
+        if (score > best)
+            best = score;
+        if (score > alpha)
+            alpha = score;
+    }
+    if ((flips = bb_flip_mask(sq3, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq3, flips, next_own, next_opp);
+        int score = -endgame_solve_2(next_own, next_opp, -beta, -alpha, sq1, sq2, false);
+        if (score > best)
+            best = score;
+    }
+    if (best == -ENDGAME_INFINITY)
+        best = passed ? endgame_final_score(own, opp) : -endgame_solve_3(opp, own, -beta, -alpha, sq1, sq2, sq3, true);
+    return best;
+}
+
+static int endgame_solve_4(ull own, ull opp, int alpha, int beta, int sq1, int sq2, int sq3, int sq4, bool passed)
+{
+    int best = -ENDGAME_INFINITY;
+    ull flips;
+    if ((flips = bb_flip_mask(sq1, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq1, flips, next_own, next_opp);
+        best = -endgame_solve_3(next_own, next_opp, -beta, -alpha, sq2, sq3, sq4, false);
+        if (best >= beta)
+            return best;
+        if (best > alpha)
+            alpha = best;
+    }
+    if ((flips = bb_flip_mask(sq2, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq2, flips, next_own, next_opp);
+        int score = -endgame_solve_3(next_own, next_opp, -beta, -alpha, sq1, sq3, sq4, false);
+        if (score >= beta)
+            return score;
+        if (score > best)
+            best = score;
+        if (score > alpha)
+            alpha = score;
+    }
+    if ((flips = bb_flip_mask(sq3, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq3, flips, next_own, next_opp);
+        int score = -endgame_solve_3(next_own, next_opp, -beta, -alpha, sq1, sq2, sq4, false);
+        if (score >= beta)
+            return score;
+        if (score > best)
+            best = score;
+        if (score > alpha)
+            alpha = score;
+    }
+    if ((flips = bb_flip_mask(sq4, own, opp)))
+    {
+        ENDGAME_PLAY(own, opp, sq4, flips, next_own, next_opp);
+        int score = -endgame_solve_3(next_own, next_opp, -beta, -alpha, sq1, sq2, sq3, false);
+        if (score > best)
+            best = score;
+    }
+    if (best == -ENDGAME_INFINITY)
+        best = passed ? endgame_final_score(own, opp) : -endgame_solve_4(opp, own, -beta, -alpha, sq1, sq2, sq3, sq4, true);
+    return best;
+}
+
+/*
+write the squares of `empty` into `squares`, those in odd quadrants first,
+and return how many there are
+*/
+static inline int endgame_parity_squares(ull empty, int *squares)
+{
+    int parity = endgame_parity(empty);
+    int n = 0;
+    for (ull bits = empty; bits; bits &= bits - 1)
+        if (parity & (1 << endgame_quadrant(bb_first_square(bits))))
+            squares[n++] = bb_first_square(bits);
+    for (ull bits = empty; bits; bits &= bits - 1)
+        if (!(parity & (1 << endgame_quadrant(bb_first_square(bits)))))
+            squares[n++] = bb_first_square(bits);
+    return n;
+}
+
+/*
+return the exact score of `own` to move, fail-soft within (alpha, beta).
+if `best_square` is not NULL it receives the best move (ENDGAME_NO_SQUARE when
+`own` has to pass or the game is over). `nodes` counts the positions visited;
+the last 4 empties are solved as one.
+*/
+static int endgame_solve(ull own, ull opp, int alpha, int beta, bool passed, int *best_square, ull *nodes)
+{
+    (*nodes)++;
+    ull empty = ~(own | opp);
+    int empties = bb_popcount(empty);
+    if (best_square == NULL && empties <= 4)
+    {
+        int squares[4];
+        endgame_parity_squares(empty, squares);
+        switch (empties)
+        {
+        case 0:
+            return endgame_final_score(own, opp);
+        case 1:
+            return endgame_solve_1(own, opp, squares[0]);
+        case 2:
+            return endgame_solve_2(own, opp, alpha, beta, squares[0], squares[1], passed);
+        case 3:
+            return endgame_solve_3(own, opp, alpha, beta, squares[0], squares[1], squares[2], passed);
+        default:
+            return endgame_solve_4(own, opp, alpha, beta, squares[0], squares[1], squares[2], squares[3], passed);
+        }
+    }
+
+    if (best_square)
+        *best_square = ENDGAME_NO_SQUARE;
+    ull moves = bb_legal_moves(own, opp);
+    if (moves == 0)
+    {
+        if (passed)
+            return endgame_final_score(own, opp);
+        return -endgame_solve(opp, own, -beta, -alpha, true, NULL, nodes);
+    }
+
+    // Order the moves: fastest first while there are many empties, parity below that
+    int parity = endgame_parity(empty);
+    int squares[32];
+    ull flip_masks[32];
+    int keys[32];
+    int n = 0;
+    for (; moves; moves &= moves - 1)
+    {
+        int sq = bb_first_square(moves);
+        ull flips = bb_flip_mask(sq, own, opp);
+        int key = (parity >> endgame_quadrant(sq)) & 1;
+        if (empties > ENDGAME_FASTEST_FIRST_EMPTIES)
+        {
+            ENDGAME_PLAY(own, opp, sq, flips, next_own, next_opp);
+            key -= 2 * bb_popcount(bb_legal_moves(next_own, next_opp));
+        }
+        int i = n++;
+        for (; i > 0 && keys[i - 1] < key; i--)
+        {
+            keys[i] = keys[i - 1];
+            squares[i] = squares[i - 1];
+            flip_masks[i] = flip_masks[i - 1];
+        }
+        keys[i] = key;
+        squares[i] = sq;
+        flip_masks[i] = flips;
+    }
+
+    int best = -ENDGAME_INFINITY;
+    for (int i = 0; i < n; i++)
+    {
+        ENDGAME_PLAY(own, opp, squares[i], flip_masks[i], next_own, next_opp);
+        int score = -endgame_solve(next_own, next_opp, -beta, -alpha, false, NULL, nodes);
+        if (score > best)
+        {
+            best = score;
+            if (best_square)
+                *best_square = squares[i];
+            if (score >= beta)
+                break;
+            if (score > alpha)
+                alpha = score;
+        }
+    }
+    return best;
+}
+
+#endif
@@ -0,0 +1,1388 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include "engine.h"
+#include "position.h"
+#include "symmetry.h"
+#include <cilk/cilk.h>
+#include <cilk/reducer_max.h>
+#include <cilk/cilk_api.h>
+using namespace std;
+
+/*
+the searches of othello.cpp, on the state of one Engine (engine.h).
+
+every search function takes the SearchContext of its engine first: the table,
+the move ordering, the grain, the counters and the time control of that engine.
+only the search stacks are shared by all engines, one per worker (see worker_stack).
+*/
+
+// Positions searched by each Cilk worker, one cache line each so that counting never contends; kept with NO_SEARCH_STATS (see stats.h)
+typedef struct alignas(64)
+{
+    ull nodes;
+} NodeCounter;
+
+struct SearchContext
+{
+    EngineConfig config;
+    TranspositionTable tt; /* shared by all Cilk workers */
+    MoveOrdering ordering; /* for the alpha-beta searches */
+    GrainControl grain;    /* of the parallel searches */
+    NodeCounter nodes[ORDER_MAX_WORKERS];
+    SearchStats stats[STATS_MAX_WORKERS]; /* see stats.h */
+
+    // Search the last moves with the specialized kernels; the benchmark turns them off to compare (see negamax_frame)
+    bool negamax_kernels;
+
+    /*
+    Time control for iterative deepening: once the deadline passes, `timed_out` is
+    set and every search unwinds as if the root had been cut off. `stopped` does the
+    same for the caller (Engine::stop); only Engine::resume clears it, so a search
+    never loses a stop issued before or while it runs.
+    */
+    double deadline; /* CLOCK_MONOTONIC seconds, 0 when the search is not timed */
+    volatile bool timed_out;
+    volatile bool stopped;
+};
+
+// True once the search is stopped by the caller or out of time: its results are meaningless from then on
+static inline bool is_stopped(SearchContext *ctx)
+{
+    return ctx->stopped || ctx->timed_out;
+}
+
+static inline ull *worker_nodes(SearchContext *ctx)
+{
+    return &ctx->nodes[__cilkrts_get_worker_number() % ORDER_MAX_WORKERS].nodes;
+}
+
+ull total_nodes(SearchContext *ctx)
+{
+    ull total = 0;
+    for (int w = 0; w < ORDER_MAX_WORKERS; w++)
+        total += ctx->nodes[w].nodes;
+    return total;
+}
+
+void reset_nodes(SearchContext *ctx)
+{
+    for (int w = 0; w < ORDER_MAX_WORKERS; w++)
+        ctx->nodes[w].nodes = 0;
+}
+
+static inline SearchStats *worker_stats(SearchContext *ctx)
+{
+    return &ctx->stats[__cilkrts_get_worker_number() % STATS_MAX_WORKERS];
+}
+
+// Ply frames of the serial searches of each Cilk worker (see search_stack.h), shared by every engine
+SearchStack search_stacks[STACK_MAX_WORKERS];
+
+static inline SearchFrame *worker_stack()
+{
+    return search_stacks[__cilkrts_get_worker_number() % STACK_MAX_WORKERS].frames;
+}
+
+// Find the move of `color` in `b` in the opening book; false if the position is not in it
+bool book_move(SearchContext *ctx, Board b, int color, Action *action, int *depth)
+{
+    BookEntry entry;
+    if (ctx->config.book == NULL ||
+        !book_probe_position(ctx->config.book, b.disks[color], b.disks[OTHERCOLOR(color)], color, &entry) ||
+        entry.square >= 64)
+        return false;
+    // A key collision could name any square; only a legal move is played
+    if (!(bb_kernel.legal_moves(b.disks[color], b.disks[OTHERCOLOR(color)]) & BB_SQUARE_BIT(entry.square)))
+        return false;
+    action->move = square_move(entry.square);
+    action->utility = entry.score;
+    *depth = entry.depth;
+    return true;
+}
+
+// Write the squares of the legal move bitboard `move` into `squares` and return how many there are
+int get_valid_squares(ull move, unsigned char *squares)
+{
+    // lowest bit first keeps the original row 8..1, column 8..1 scan order
+    int n = 0;
+    for (; move; move &= move - 1)
+        squares[n++] = (unsigned char)bb_first_square(move);
+    return n;
+}
+
+// Score and best move left in `frame` by a serial search
+Action frame_action(const SearchFrame *frame)
+{
+    Action action;
+    action.utility = frame->score;
+    action.move = square_move(frame->best);
+    return action;
+}
+
+// Set up the search position of board `b` with `color` to move (see position.h)
+Position board_position(Board b, int color)
+{
+    Position pos;
+    position_set(&pos, b.disks, color);
+    return pos;
+}
+
+// Write the legal moves `move` of `pos` into `squares`, best first (see ordering.h), and return how many there are
+int get_ordered_squares(SearchContext *ctx, const Position *pos, ull move, int ply, int hash_square, unsigned char *squares)
+{
+    return order_moves(&ctx->ordering, __cilkrts_get_worker_number(), pos->color, ply, pos->own, pos->opp, move,
+                       hash_square, squares);
+}
+
+// Feed a beta cutoff by the `index`-th move searched, on square `sq`, back into the move ordering
+void record_cutoff(SearchContext *ctx, int color, int ply, int sq, int depth, int index)
+{
+    STATS(worker_stats(ctx)->cutoffs++);
+    ordering_cutoff(&ctx->ordering, __cilkrts_get_worker_number(), color, ply, sq, depth, index);
+}
+
+// Return true if the subtree below `pos` is too small to be worth spawning for
+bool search_serially(SearchContext *ctx, const Position *pos, int depth, bool pruning)
+{
+    int mobility = bb_popcount(position_legal_moves(pos));
+    return grain_serial(&ctx->grain, mobility, depth, pruning);
+}
+
+// Legal moves of `pos` to search `depth` moves ahead: one of each set of moves that are images under a symmetry of `pos`
+ull search_moves(const Position *pos, int depth)
+{
+    ull moves = position_legal_moves(pos);
+    return depth >= SYMMETRY_MIN_DEPTH ? symmetry_unique_moves(pos->own, pos->opp, moves) : moves;
+}
+
+// Look up board `key` in the transposition table, counting probes and hits
+bool probe_table(SearchContext *ctx, ull key, TTResult *hit)
+{
+    STATS(worker_stats(ctx)->tt_probes++);
+    if (!tt_probe(&ctx->tt, key, hit))
+        return false;
+    STATS(worker_stats(ctx)->tt_hits++);
+    return true;
+}
+
+// Log an exact result of `pos` in the position cache, if the engine has one
+void add_to_cache(SearchContext *ctx, const Position *pos, int depth, int score, int square)
+{
+    if (ctx->config.cache)
+        cache_add(ctx->config.cache, pos->own, pos->opp, pos->color, depth, score, square);
+}
+
+// Look up an exact result of `pos` searched at least `depth` moves ahead in the position cache
+bool probe_cache(SearchContext *ctx, const Position *pos, int depth, int *score, int *square)
+{
+    BookEntry entry;
+    if (ctx->config.cache == NULL || !cache_probe(ctx->config.cache, pos->own, pos->opp, pos->color, depth, &entry))
+        return false;
+    STATS(worker_stats(ctx)->tt_cutoffs++);
+    *score = entry.score;
+    *square = (entry.square < 64) ? entry.square : ORDER_NO_SQUARE;
+    return true;
+}
+
+/*
+Look up an exact score for `pos` searched at least `depth` moves ahead, in
+the transposition table and then in the position cache.
+The negamax searches never prune, so every score they store is exact.
+`square` receives the stored best move, TT_NO_MOVE if there is none.
+*/
+bool probe_exact(SearchContext *ctx, const Position *pos, int depth, int *score, int *square)
+{
+    TTResult hit;
+    if (depth < TT_MIN_DEPTH)
+        return false;
+    if (!probe_table(ctx, pos->key, &hit) || hit.bound != TT_EXACT || hit.depth < depth)
+        return probe_cache(ctx, pos, depth, score, square);
+    STATS(worker_stats(ctx)->tt_cutoffs++);
+    *score = hit.score;
+    *square = hit.move;
+    return true;
+}
+
+// Store an exact score and its best move `square` (past the board when there is none)
+void store_exact(SearchContext *ctx, const Position *pos, int depth, int score, int square)
+{
+    if (depth >= TT_MIN_DEPTH)
+        tt_store(&ctx->tt, pos->key, depth, TT_EXACT, score, square < 64 ? square : TT_NO_MOVE);
+    add_to_cache(ctx, pos, depth, score, square);
+}
+
+/*
+Leaf-adjacent negamax kernels: the last NEGAMAX_KERNEL_DEPTH moves of serial_negamax,
+specialized at compile time on the side to move and the remaining depth. The depth
+tests and the transposition table tests fold away, the hash keys of the mover are a
+constant table and the recursion unrolls into direct calls. At depth 1 the children
+are scored from the disks each move flips, without making the move. They count and
+store exactly what negamax_frame does, so the node counts do not change.
+*/
+#define NEGAMAX_KERNEL_DEPTH 3
+
+template <int COLOR, int DEPTH>
+struct NegamaxKernel
+{
+    static int search(SearchContext *ctx, Position *pos, SearchFrame *frame)
+    {
+        ull *nodes = worker_nodes(ctx);
+        STATS(SearchStats *stats = worker_stats(ctx));
+        (*nodes)++;
+        STATS(stats_node(stats, DEPTH));
+        frame->best = STACK_NO_SQUARE;
+
+        int square;
+        if (DEPTH >= TT_MIN_DEPTH && probe_exact(ctx, pos, DEPTH, &frame->score, &square))
+        {
+            frame->best = (square < 64) ? square : STACK_NO_SQUARE;
+            return frame->score;
+        }
+
+        ull moves = position_legal_moves(pos);
+        if (DEPTH == 1)
+        {
+            *nodes += bb_popcount(moves);
+            STATS(stats->nodes[0] += bb_popcount(moves));
+            STATS(stats->leaves += bb_popcount(moves));
+        }
+        frame->score = -100;
+        for (ull bits = moves; bits; bits &= bits - 1)
+        {
+            int sq = bb_first_square(bits);
+            int score;
+            if (DEPTH == 1)
+                score = position_score(pos) + 2 * bb_popcount(bb_kernel.flip_mask(sq, pos->own, pos->opp)) + 1;
+            else
+            {
+                position_make_as<COLOR>(pos, sq, &frame->undo);
+                score = -NegamaxKernel<1 - COLOR, DEPTH - 1>::search(ctx, pos, frame + 1);
+                position_unmake(pos, &frame->undo);
+            }
+            if (score > frame->score)
+            {
+                frame->best = sq;
+                frame->score = score;
+            }
+        }
+
+        if (moves == 0)
+        {
+            if (!position_can_pass(pos))
+            {
+                STATS(stats->leaves++);
+                frame->score = position_score(pos);
+            }
+            else
+            {
+                STATS(stats->passes++);
+                position_pass(pos);
+                frame->score = -NegamaxKernel<1 - COLOR, DEPTH>::search(ctx, pos, frame + 1);
+                position_pass(pos);
+            }
+        }
+
+        if (DEPTH >= TT_MIN_DEPTH)
+            store_exact(ctx, pos, DEPTH, frame->score, frame->best);
+        return frame->score;
+    }
+};
+
+template <int COLOR>
+struct NegamaxKernel<COLOR, 0>
+{
+    static int search(SearchContext *ctx, Position *pos, SearchFrame *frame)
+    {
+        (*worker_nodes(ctx))++;
+        STATS(stats_node(worker_stats(ctx), 0));
+        STATS(worker_stats(ctx)->leaves++);
+        frame->best = STACK_NO_SQUARE;
+        return frame->score = position_score(pos);
+    }
+};
+
+typedef int (*NegamaxKernelFn)(SearchContext *ctx, Position *pos, SearchFrame *frame);
+
+// Kernels by side to move and remaining depth
+const NegamaxKernelFn negamax_kernel_table[2][NEGAMAX_KERNEL_DEPTH + 1] = {
+    {NegamaxKernel<X_BLACK, 0>::search, NegamaxKernel<X_BLACK, 1>::search, NegamaxKernel<X_BLACK, 2>::search, NegamaxKernel<X_BLACK, 3>::search},
+    {NegamaxKernel<O_WHITE, 0>::search, NegamaxKernel<O_WHITE, 1>::search, NegamaxKernel<O_WHITE, 2>::search, NegamaxKernel<O_WHITE, 3>::search}};
+
+// serial_negamax of `pos` on the ply frames from `frame` on; `frame` receives the score and the best move
+int negamax_frame(SearchContext *ctx, Position *pos, SearchFrame *frame, int depth)
+{
+    if (ctx->negamax_kernels && depth <= NEGAMAX_KERNEL_DEPTH)
+        return negamax_kernel_table[pos->color][depth](ctx, pos, frame);
+    (*worker_nodes(ctx))++;
+    STATS(stats_node(worker_stats(ctx), depth));
+    frame->best = STACK_NO_SQUARE;
+    if (depth == 0)
+    {
+        // If depth is 0, return the utility score of this move
+        STATS(worker_stats(ctx)->leaves++);
+        return frame->score = position_score(pos);
+    }
+    // A stopped search (Engine::stop) unwinds with a meaningless score, which is never stored
+    if (is_stopped(ctx))
+        return frame->score = 0;
+
+    // Reuse the score if this board was already searched deep enough
+    int square;
+    if (probe_exact(ctx, pos, depth, &frame->score, &square))
+    {
+        frame->best = (square < 64) ? square : STACK_NO_SQUARE;
+        return frame->score;
+    }
+
+    /*
+    Find the best position for placing a new `color` disk
+    The definition of best position depends on which player is placing in the computer turn
+    If player1 is placing in the initial computer turn, then player1 aims to maximize the
+    utiltiy score, while player2 tries to minimize player1's utility score
+    */
+    ull moves = search_moves(pos, depth);
+    frame->score = -100;
+    for (ull bits = moves; bits; bits &= bits - 1)
+    {
+        int sq = bb_first_square(bits);
+        position_make(pos, sq, &frame->undo);
+        int score = -negamax_frame(ctx, pos, frame + 1, depth - 1);
+        position_unmake(pos, &frame->undo);
+        if (score > frame->score)
+        {
+            frame->best = sq;
+            frame->score = score;
+        }
+    }
+
+    // If player is not movable, check if the other player can move
+    if (moves == 0)
+    {
+        // Both players cannot move return the utility score of this move
+        if (!position_can_pass(pos))
+        {
+            STATS(worker_stats(ctx)->leaves++);
+            frame->score = position_score(pos);
+        }
+        // The other player can move, then keep searching
+        else
+        {
+            STATS(worker_stats(ctx)->passes++);
+            position_pass(pos);
+            frame->score = -negamax_frame(ctx, pos, frame + 1, depth);
+            position_pass(pos);
+        }
+    }
+
+    if (!is_stopped(ctx))
+        store_exact(ctx, pos, depth, frame->score, frame->best);
+    return frame->score;
+}
+
+// Return the best action given board status and searching `depth` moves ahead for placing a `color` disk
+Action serial_negamax(SearchContext *ctx, Board b, int color, int depth)
+{
+    Position pos = board_position(b, color);
+    SearchFrame *frame = worker_stack();
+    negamax_frame(ctx, &pos, frame, depth);
+    return frame_action(frame);
+}
+
+// parallel_negamax of `pos`, which the search is free to change
+Action negamax_node(SearchContext *ctx, Position pos, int depth)
+{
+    // Switch to the serial mode to increase granularity
+    if (search_serially(ctx, &pos, depth, false))
+    {
+        SearchFrame *frame = worker_stack();
+        negamax_frame(ctx, &pos, frame, depth);
+        return frame_action(frame);
+    }
+    else
+    {
+        (*worker_nodes(ctx))++;
+        STATS(stats_node(worker_stats(ctx), depth));
+        Action best_action = {0, {0, 0}};
+        if (is_stopped(ctx))
+            return best_action;
+
+        // Reuse the score if this board was already searched deep enough
+        int square;
+        if (probe_exact(ctx, &pos, depth, &best_action.utility, &square))
+        {
+            best_action.move = square_move(square);
+            return best_action;
+        }
+
+        // Initialize essential variables and get valid positions for placing a new `color` disk
+        unsigned char squares[STACK_MAX_MOVES];
+        int num_of_legal_moves = get_valid_squares(search_moves(&pos, depth), squares);
+
+        /*
+        Use reducer to find the best position for placing a new `color` disk
+        The definition of best position depends on which player is placing in the computer turn
+        If player1 is placing in the initial computer turn, then player1 aims to maximize the
+        utiltiy score, while player2 tries to minimize player1's utility score
+        */
+        cilk::reducer_max_index<int, int> max_reducer;
+        int home = __cilkrts_get_worker_number();
+        cilk_for(int i = 0; i < num_of_legal_moves; i++)
+        {
+            grain_count_child(&ctx->grain, home, __cilkrts_get_worker_number());
+            Position child = pos;
+            PositionUndo undo;
+            position_make(&child, squares[i], &undo);
+            // Update max score
+            max_reducer.calc_max(i, -negamax_node(ctx, child, depth - 1).utility);
+        }
+
+        // If player is not movable, check if the other player can move
+        square = STACK_NO_SQUARE;
+        if (num_of_legal_moves == 0)
+        {
+            // Both players cannot move return the utility score of this move
+            if (!position_can_pass(&pos))
+            {
+                STATS(worker_stats(ctx)->leaves++);
+                best_action.utility = position_score(&pos);
+            }
+            // The other player can move, then keep searching
+            else
+            {
+                STATS(worker_stats(ctx)->passes++);
+                Position child = pos;
+                position_pass(&child);
+                best_action = negamax_node(ctx, child, depth);
+                best_action.utility = -best_action.utility;
+            }
+        }
+        else
+        {
+            // Finish searching at this depth, return best move for this board status
+            square = squares[max_reducer.get_index()];
+            best_action.move = square_move(square);
+            best_action.utility = max_reducer.get_value();
+        }
+
+        if (!is_stopped(ctx))
+            store_exact(ctx, &pos, depth, best_action.utility, square);
+        return best_action;
+    };
+}
+
+// Return the best action given board status and searching `depth` moves ahead for placing a `color` disk
+Action parallel_negamax(SearchContext *ctx, Board b, int color, int depth)
+{
+    return negamax_node(ctx, board_position(b, color), depth);
+}
+
+/*
+Narrow [alpha, beta] with a stored bound for `pos` searched at least `depth` moves ahead.
+Return true if the stored entry alone decides the node; `score` then holds its score.
+`square` receives the stored best move, if there is one, and is left alone otherwise.
+*/
+bool probe_bounds(SearchContext *ctx, const Position *pos, int depth, int *alpha, int *beta, int *score, int *square)
+{
+    TTResult hit;
+    if (depth < TT_MIN_DEPTH)
+        return false;
+    if (!probe_table(ctx, pos->key, &hit))
+        return probe_cache(ctx, pos, depth, score, square);
+    // Even the best move of a shallower search is a good first guess for this one
+    if (hit.move != TT_NO_MOVE)
+        *square = hit.move;
+    if (hit.depth < depth)
+        return probe_cache(ctx, pos, depth, score, square);
+    if (hit.bound == TT_LOWER && hit.score > *alpha)
+        *alpha = hit.score;
+    else if (hit.bound == TT_UPPER && hit.score < *beta)
+        *beta = hit.score;
+    if (hit.bound != TT_EXACT && *alpha < *beta)
+        return probe_cache(ctx, pos, depth, score, square);
+    STATS(worker_stats(ctx)->tt_cutoffs++);
+    *score = hit.score;
+    return true;
+}
+
+// Store the result of an alpha-beta search of window [alpha_orig, beta] as an exact score or a bound
+void store_bounds(SearchContext *ctx, const Position *pos, int depth, int alpha_orig, int beta, int score, int square)
+{
+    if (depth < TT_MIN_DEPTH)
+        return;
+    int bound = TT_EXACT;
+    if (score <= alpha_orig)
+        bound = TT_UPPER;
+    else if (score >= beta)
+        bound = TT_LOWER;
+    tt_store(&ctx->tt, pos->key, depth, bound, score, square < 64 ? square : TT_NO_MOVE);
+    if (bound == TT_EXACT)
+        add_to_cache(ctx, pos, depth, score, square);
+}
+
+/*
+A node whose younger children are searched in parallel. When one child fails high
+the node sets `aborted`, and every search below it (including the children still
+running) gives up at its next check. Searches test the whole chain up to the root,
+so a cutoff also stops everything spawned underneath the node.
+*/
+typedef struct SplitPoint
+{
+    volatile bool aborted;
+    struct SplitPoint *parent;
+} SplitPoint;
+
+// Stop the search if its time budget is spent
+void check_deadline(SearchContext *ctx)
+{
+    if (ctx->deadline > 0 && now_seconds() > ctx->deadline)
+        ctx->timed_out = true;
+}
+
+// Return true if the search is out of time or this split point or any split point above it has been cut off
+bool is_aborted(SearchContext *ctx, SplitPoint *sp)
+{
+    if (is_stopped(ctx))
+        return true;
+    for (; sp; sp = sp->parent)
+        if (sp->aborted)
+            return true;
+    return false;
+}
+
+/* with this many empties or fewer, a search that reaches the end of the game runs the serial endgame solver */
+#define ENDGAME_SERIAL_EMPTIES 12
+
+// Exact score and best move of `pos` from the serial endgame solver (endgame.h), left in `frame`
+int endgame_frame(SearchContext *ctx, const Position *pos, SearchFrame *frame, int alpha, int beta, SplitPoint *sp)
+{
+    frame->best = STACK_NO_SQUARE;
+    frame->score = 0;
+    check_deadline(ctx);
+    if (is_aborted(ctx, sp))
+        return frame->score;
+
+    int square;
+    ull nodes = 0;
+    frame->score = endgame_solve(pos->own, pos->opp, alpha, beta, false, &square, &nodes);
+    *worker_nodes(ctx) += nodes;
+    STATS(worker_stats(ctx)->endgame_nodes += nodes);
+    if (square != ENDGAME_NO_SQUARE)
+        frame->best = square;
+    return frame->score;
+}
+
+/*
+Serial alpha-beta search below the parallel search (same algorithm as alphabeta_negamax in othello-serial.cpp).
+It makes and unmakes the moves on `pos` and keeps its move lists in the ply frames from `frame` on, which
+is the worker's own search stack: a serial search never spawns, so nothing else can run on this worker until
+it returns. `frame` receives the score and the best move.
+Once `sp` is aborted it returns early with a meaningless score, which is never stored.
+*/
+int alphabeta_frame(SearchContext *ctx, Position *pos, SearchFrame *frame, int depth, int ply, int alpha, int beta, SplitPoint *sp)
+{
+    (*worker_nodes(ctx))++;
+    STATS(stats_node(worker_stats(ctx), depth));
+    frame->best = STACK_NO_SQUARE;
+    if (depth == 0)
+    {
+        STATS(worker_stats(ctx)->leaves++);
+        return frame->score = position_score(pos);
+    }
+    frame->score = 0;
+    if (depth >= 2)
+        check_deadline(ctx);
+    if (is_aborted(ctx, sp))
+        return frame->score;
+
+    // A search that reaches the end of the game anyway is an exact solve, and the endgame solver is faster at it
+    if (depth >= pos->empties && pos->empties <= ENDGAME_SERIAL_EMPTIES)
+        return endgame_frame(ctx, pos, frame, alpha, beta, sp);
+
+    // A stored bound may already decide this node, or at least narrow the window and give a first move to try
+    int alpha_orig = alpha;
+    int hash_square = ORDER_NO_SQUARE;
+    if (probe_bounds(ctx, pos, depth, &alpha, &beta, &frame->score, &hash_square))
+    {
+        frame->best = hash_square;
+        return frame->score;
+    }
+
+    frame->nmoves = get_ordered_squares(ctx, pos, search_moves(pos, depth), ply, hash_square, frame->moves);
+
+    frame->score = -100;
+    for (int i = 0; i < frame->nmoves; i++)
+    {
+        int sq = frame->moves[i];
+        position_make(pos, sq, &frame->undo);
+        int score = -alphabeta_frame(ctx, pos, frame + 1, depth - 1, ply + 1, -beta, -alpha, sp);
+        position_unmake(pos, &frame->undo);
+        if (score > frame->score)
+        {
+            frame->best = sq;
+            frame->score = score;
+        }
+        alpha = (frame->score > alpha) ? frame->score : alpha;
+        if (alpha >= beta)
+        {
+            record_cutoff(ctx, pos->color, ply, sq, depth, i);
+            break;
+        }
+    }
+
+    // If player is not movable, check if the other player can move
+    if (frame->nmoves == 0)
+    {
+        if (!position_can_pass(pos))
+        {
+            STATS(worker_stats(ctx)->leaves++);
+            frame->score = position_score(pos);
+        }
+        else
+        {
+            STATS(worker_stats(ctx)->passes++);
+            position_pass(pos);
+            frame->score = -alphabeta_frame(ctx, pos, frame + 1, depth, ply + 1, -beta, -alpha, sp);
+            position_pass(pos);
+        }
+    }
+
+    if (!is_aborted(ctx, sp))
+        store_bounds(ctx, pos, depth, alpha_orig, beta, frame->score, frame->best);
+    return frame->score;
+}
+
+Action alphabeta_node(SearchContext *ctx, Position pos, int depth, int ply, int alpha, int beta, SplitPoint *parent);
+
+// Result of a younger child searched in parallel; `complete` is false if its search was aborted
+typedef struct
+{
+    int utility;
+    bool complete;
+} ChildResult;
+
+/*
+Search one younger child with a null window around alpha (PVS). Only a child that
+beats alpha needs its exact score, so it is searched again with the full window.
+A child that reaches beta cuts off its parent and aborts its running siblings.
+*/
+void search_younger_child(SearchContext *ctx, Position pos, int square, int depth, int ply, int alpha, int beta, SplitPoint *sp, int home, ChildResult *result)
+{
+    grain_count_child(&ctx->grain, home, __cilkrts_get_worker_number());
+    PositionUndo undo;
+    position_make(&pos, square, &undo);
+    int current_utility = -alphabeta_node(ctx, pos, depth - 1, ply + 1, -alpha - 1, -alpha, sp).utility;
+    if (current_utility > alpha && current_utility < beta && !is_aborted(ctx, sp))
+        current_utility = -alphabeta_node(ctx, pos, depth - 1, ply + 1, -beta, -alpha, sp).utility;
+
+    result->utility = current_utility;
+    result->complete = !is_aborted(ctx, sp);
+    if (result->complete && current_utility >= beta)
+        sp->aborted = true;
+}
+
+/*
+Parallel alpha-beta search with the Young Brothers Wait Concept: the first (eldest)
+child is searched alone to establish a bound, then the younger children are spawned
+together with null windows. Subtrees too small to be worth a spawn (see grain.h) are
+searched serially. `pos` is this node's own copy: the eldest child is made and unmade
+on it, every younger child gets a copy of its own.
+*/
+Action alphabeta_node(SearchContext *ctx, Position pos, int depth, int ply, int alpha, int beta, SplitPoint *parent)
+{
+    // A search that reaches the end of the game anyway is an exact solve: near the end, hand it to the endgame solver
+    if (depth >= pos.empties && pos.empties <= ENDGAME_SERIAL_EMPTIES)
+    {
+        SearchFrame *frame = worker_stack();
+        endgame_frame(ctx, &pos, frame, alpha, beta, parent);
+        return frame_action(frame);
+    }
+
+    // Switch to the serial mode to increase granularity
+    if (search_serially(ctx, &pos, depth, true))
+    {
+        SearchFrame *frame = worker_stack();
+        alphabeta_frame(ctx, &pos, frame, depth, ply, alpha, beta, parent);
+        return frame_action(frame);
+    }
+
+    (*worker_nodes(ctx))++;
+    STATS(stats_node(worker_stats(ctx), depth));
+    Action best_action;
+    best_action.utility = 0;
+    if (is_aborted(ctx, parent))
+        return best_action;
+
+    // The best move of an earlier search of this board (e.g. the previous iteration) is searched first
+    int alpha_orig = alpha;
+    int hash_square = ORDER_NO_SQUARE;
+    if (probe_bounds(ctx, &pos, depth, &alpha, &beta, &best_action.utility, &hash_square))
+    {
+        best_action.move = square_move(hash_square);
+        return best_action;
+    }
+
+    // The move list lives in this (Cilk) frame: a stolen continuation may read it from another worker
+    unsigned char squares[STACK_MAX_MOVES];
+    int num_of_legal_moves = get_ordered_squares(ctx, &pos, search_moves(&pos, depth), ply, hash_square, squares);
+    int best_square = STACK_NO_SQUARE;
+
+    if (num_of_legal_moves == 0)
+    {
+        if (!position_can_pass(&pos))
+        {
+            STATS(worker_stats(ctx)->leaves++);
+            best_action.utility = position_score(&pos);
+        }
+        else
+        {
+            STATS(worker_stats(ctx)->passes++);
+            position_pass(&pos);
+            best_action.utility = -alphabeta_node(ctx, pos, depth, ply + 1, -beta, -alpha, parent).utility;
+            position_pass(&pos);
+        }
+    }
+    else
+    {
+        // Eldest brother first, alone
+        PositionUndo undo;
+        position_make(&pos, squares[0], &undo);
+        best_square = squares[0];
+        best_action.utility = -alphabeta_node(ctx, pos, depth - 1, ply + 1, -beta, -alpha, parent).utility;
+        position_unmake(&pos, &undo);
+        if (is_aborted(ctx, parent))
+            return best_action;
+
+        if (best_action.utility >= beta)
+            record_cutoff(ctx, pos.color, ply, squares[0], depth, 0);
+        else if (num_of_legal_moves > 1)
+        {
+            alpha = (best_action.utility > alpha) ? best_action.utility : alpha;
+
+            // Younger brothers in parallel
+            SplitPoint sp = {false, parent};
+            ChildResult results[STACK_MAX_MOVES];
+            int home = __cilkrts_get_worker_number();
+            for (int i = 1; i < num_of_legal_moves; i++)
+                cilk_spawn search_younger_child(ctx, pos, squares[i], depth, ply, alpha, beta, &sp, home, &results[i]);
+            cilk_sync;
+            if (is_aborted(ctx, parent))
+                return best_action;
+
+            int cutoff_index = -1;
+            for (int i = 1; i < num_of_legal_moves; i++)
+            {
+                if (!results[i].complete)
+                    continue;
+                if (results[i].utility > best_action.utility)
+                {
+                    best_square = squares[i];
+                    best_action.utility = results[i].utility;
+                }
+                if (results[i].utility >= beta && cutoff_index < 0)
+                    cutoff_index = i;
+            }
+            if (cutoff_index > 0)
+                record_cutoff(ctx, pos.color, ply, squares[cutoff_index], depth, cutoff_index);
+        }
+    }
+
+    best_action.move = square_move(best_square);
+    if (!is_aborted(ctx, parent))
+        store_bounds(ctx, &pos, depth, alpha_orig, beta, best_action.utility, best_square);
+    return best_action;
+}
+
+// Search board `b` with `color` to move `depth` moves ahead within [alpha, beta] (see alphabeta_node)
+Action parallel_alphabeta(SearchContext *ctx, Board b, int color, int depth, int ply, int alpha, int beta, SplitPoint *parent)
+{
+    return alphabeta_node(ctx, board_position(b, color), depth, ply, alpha, beta, parent);
+}
+
+/*
+Lazy SMP: every worker runs its own serial alpha-beta search (alphabeta_frame, the
+algorithm of alphabeta_negamax) from the root, and the searches share nothing but
+the transposition table. Thread 0 is the main search and its result is the one
+returned; the helpers only fill the table for it. To keep them from all walking
+the same tree in step, odd helpers search one move deeper and helper i starts at
+the i-th root move, and their per-worker killers and history soon order every
+other node differently too. Once the main search is done the helpers are cut off
+through a split point of their own.
+*/
+
+// Root of Lazy SMP helper `rotate`: alphabeta_frame below every root move, the moves taken from the `rotate`-th on
+int lazy_smp_helper(SearchContext *ctx, Position *pos, SearchFrame *frame, int depth, int rotate, SplitPoint *sp)
+{
+    int alpha = -100, beta = 100;
+    int hash_square = ORDER_NO_SQUARE;
+    frame->best = STACK_NO_SQUARE;
+    if (probe_bounds(ctx, pos, depth, &alpha, &beta, &frame->score, &hash_square))
+        return frame->score;
+    frame->nmoves = get_ordered_squares(ctx, pos, search_moves(pos, depth), 0, hash_square, frame->moves);
+    if (frame->nmoves == 0)
+        return alphabeta_frame(ctx, pos, frame, depth, 0, alpha, beta, sp);
+
+    int alpha_orig = alpha;
+    frame->score = -100;
+    for (int i = 0; i < frame->nmoves && !is_aborted(ctx, sp); i++)
+    {
+        int sq = frame->moves[(i + rotate) % frame->nmoves];
+        position_make(pos, sq, &frame->undo);
+        int score = -alphabeta_frame(ctx, pos, frame + 1, depth - 1, 1, -beta, -alpha, sp);
+        position_unmake(pos, &frame->undo);
+        if (score > frame->score)
+        {
+            frame->best = sq;
+            frame->score = score;
+        }
+        alpha = (frame->score > alpha) ? frame->score : alpha;
+        if (alpha >= beta)
+            break;
+    }
+    if (!is_aborted(ctx, sp))
+        store_bounds(ctx, pos, depth, alpha_orig, beta, frame->score, frame->best);
+    return frame->score;
+}
+
+// Return the best action of `color` in `b` searching `depth` moves ahead with one Lazy SMP thread per worker
+Action lazy_smp(SearchContext *ctx, Board b, int color, int depth)
+{
+    int nthreads = __cilkrts_get_nworkers();
+    SplitPoint helpers = {false, NULL};
+    Action best_action;
+    cilk_for(int i = 0; i < nthreads; i++)
+    {
+        Position pos = board_position(b, color);
+        SearchFrame *frame = worker_stack();
+        if (i == 0)
+        {
+            alphabeta_frame(ctx, &pos, frame, depth, 0, -100, 100, NULL);
+            best_action = frame_action(frame);
+            helpers.aborted = true;
+        }
+        else if (!helpers.aborted)
+            lazy_smp_helper(ctx, &pos, frame, depth + (i & 1), i, &helpers);
+    }
+    return best_action;
+}
+
+// Return the best action of `color` in `b` searching `depth` moves ahead with the engine `engine`
+Action engine_search(SearchContext *ctx, int engine, Board b, int color, int depth)
+{
+    if (engine == ENGINE_SERIAL_NEGAMAX_GENERIC)
+    {
+        // The baseline of the specialized kernels
+        ctx->negamax_kernels = false;
+        Action action = serial_negamax(ctx, b, color, depth);
+        ctx->negamax_kernels = true;
+        return action;
+    }
+    if (engine == ENGINE_SERIAL_NEGAMAX)
+        return serial_negamax(ctx, b, color, depth);
+    if (engine == ENGINE_NEGAMAX)
+        return parallel_negamax(ctx, b, color, depth);
+    if (engine == ENGINE_LAZY_SMP)
+        return lazy_smp(ctx, b, color, depth);
+    return parallel_alphabeta(ctx, b, color, depth, 0, -100, 100, NULL);
+}
+
+// Parse an engine name: alphabeta, negamax or lazysmp; false on anything else
+bool parse_engine(const char *text, int *engine)
+{
+    if (strcmp(text, "alphabeta") == 0)
+        *engine = ENGINE_ALPHABETA;
+    else if (strcmp(text, "negamax") == 0)
+        *engine = ENGINE_NEGAMAX;
+    else if (strcmp(text, "lazysmp") == 0)
+        *engine = ENGINE_LAZY_SMP;
+    else
+        return false;
+    return true;
+}
+
+/*
+Parse a position in the text format (64 squares, then the side to move) at the
+start of `text`. Return a pointer just past the side to move, or NULL if `text`
+does not start with a position.
+*/
+const char *parse_position(const char *text, Board *b, int *color)
+{
+    b->disks[X_BLACK] = b->disks[O_WHITE] = 0;
+    int squares = 0;
+    const char *p = text;
+    for (; *p && squares < 64; p++)
+    {
+        if (*p == ' ' || *p == '\t')
+            continue;
+        int sq = 63 - squares; /* row 1, column 1 is bit 63 */
+        if (*p == 'X' || *p == 'x' || *p == '*')
+            b->disks[X_BLACK] |= BB_SQUARE_BIT(sq);
+        else if (*p == 'O' || *p == 'o')
+            b->disks[O_WHITE] |= BB_SQUARE_BIT(sq);
+        else if (*p != '-' && *p != '.')
+            return NULL;
+        squares++;
+    }
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (squares < 64 || !(*p == 'X' || *p == 'x' || *p == '*' || *p == 'O' || *p == 'o'))
+        return NULL;
+    *color = (*p == 'O' || *p == 'o') ? O_WHITE : X_BLACK;
+    return p + 1;
+}
+
+/*
+Multi-PV analysis (-V): the best `k` root moves, each with its exact score and
+principal variation, instead of the best move alone.
+
+The root moves are ordered as in any search and the first k are searched with the
+full window, in parallel. The k-th best exact score is then a bound shared by the
+searches of the other moves, which also run in parallel: each is searched with a
+null window on the bound, and only a move that beats it is searched again for its
+exact score. Such a move enters the top k, pushes the last one out and raises the
+bound for the searches that start after it. A move that stays below the bound
+keeps an upper bound instead of a score: it is cut off as soon as it is clear it
+cannot make the top k. With k at least the number of moves, every move is
+searched with the full window.
+
+The principal variations are read back from the transposition table, following the
+best move stored for every position from the root move on. They end early where
+the table has no entry: at the last ply (nodes that close to the leaves are not
+stored), in the endgame solver, and where an entry was replaced.
+*/
+#define MULTIPV_NO_BOUND -101 /* below any score */
+
+// Root moves searched by multi_pv and the bound they share
+typedef struct
+{
+    RootMove *moves;
+    int nmoves;
+    int k;
+    std::atomic<int> bound; /* the k-th best exact score so far */
+    std::atomic_flag lock;  /* held to change `bound` and the exact scores */
+} MultiPvRoot;
+
+// Ranking of the root moves: exact scores first, best first, in search order among equal scores
+bool root_move_better(const RootMove &a, const RootMove &b)
+{
+    if (a.exact != b.exact)
+        return a.exact;
+    return a.exact && a.score > b.score;
+}
+
+// The k-th best exact score of `root`, MULTIPV_NO_BOUND while fewer than k are known
+int multipv_bound(const MultiPvRoot *root)
+{
+    int scores[STACK_MAX_MOVES];
+    int nscores = 0;
+    for (int i = 0; i < root->nmoves; i++)
+        if (root->moves[i].exact)
+            scores[nscores++] = root->moves[i].score;
+    if (nscores < root->k)
+        return MULTIPV_NO_BOUND;
+    nth_element(scores, scores + root->k - 1, scores + nscores, greater<int>());
+    return scores[root->k - 1];
+}
+
+// Search root move `i` of `root`, `depth` moves ahead, for an exact score if it beats the bound
+void search_multipv_move(SearchContext *ctx, Position pos, int depth, MultiPvRoot *root, int i)
+{
+    RootMove *move = &root->moves[i];
+    PositionUndo undo;
+    position_make(&pos, move->square, &undo);
+    int bound = root->bound.load();
+    int score = 100;
+    if (bound > MULTIPV_NO_BOUND)
+        score = -alphabeta_node(ctx, pos, depth - 1, 1, -bound - 1, -bound, NULL).utility;
+    if (score > bound)
+        score = -alphabeta_node(ctx, pos, depth - 1, 1, -100, -bound, NULL).utility;
+
+    if (score <= bound)
+    {
+        move->score = score;
+        return;
+    }
+    while (root->lock.test_and_set(std::memory_order_acquire))
+        ;
+    move->score = score;
+    move->exact = true;
+    root->bound = multipv_bound(root);
+    root->lock.clear(std::memory_order_release);
+}
+
+// Follow the best moves stored in the transposition table from root move `move` of `pos`, `depth` moves ahead
+void principal_variation(SearchContext *ctx, Position pos, RootMove *move, int depth)
+{
+    PositionUndo undo;
+    TTResult hit;
+    move->npv = 0;
+    move->pv[move->npv++] = move->square;
+    position_make(&pos, move->square, &undo);
+    while (depth > 1 && move->npv < MULTIPV_MAX_PLIES)
+    {
+        ull moves = position_legal_moves(&pos);
+        if (moves == 0)
+        {
+            if (!position_can_pass(&pos))
+                break;
+            // A pass does not count as a move of the search depth
+            position_pass(&pos);
+            move->pv[move->npv++] = MULTIPV_PASS;
+            continue;
+        }
+        if (!tt_probe(&ctx->tt, pos.key, &hit) || hit.move == TT_NO_MOVE || !(moves & BB_SQUARE_BIT(hit.move)))
+            break;
+        move->pv[move->npv++] = hit.move;
+        position_make(&pos, hit.move, &undo);
+        depth--;
+    }
+}
+
+/*
+Rank the legal moves of `color` in `b`, searched `depth` moves ahead, into `moves`
+(room for STACK_MAX_MOVES) and return how many there are. The first `k` have exact
+scores and principal variations (all of them if there are fewer than k moves), the
+others only upper bounds, at most the k-th score.
+*/
+int multi_pv(SearchContext *ctx, Board b, int color, int depth, int k, RootMove *moves)
+{
+    Position pos = board_position(b, color);
+    TTResult hit;
+    int hash_square = (tt_probe(&ctx->tt, pos.key, &hit) && hit.move != TT_NO_MOVE) ? hit.move : ORDER_NO_SQUARE;
+    unsigned char squares[STACK_MAX_MOVES];
+    int nmoves = get_ordered_squares(ctx, &pos, position_legal_moves(&pos), 0, hash_square, squares);
+
+    MultiPvRoot root;
+    root.moves = moves;
+    root.nmoves = nmoves;
+    root.k = (k < nmoves) ? k : nmoves;
+    root.bound = MULTIPV_NO_BOUND;
+    root.lock.clear();
+    for (int i = 0; i < nmoves; i++)
+    {
+        moves[i].square = squares[i];
+        moves[i].score = 100;
+        moves[i].exact = false;
+        moves[i].npv = 0;
+    }
+
+    // The best k by the move ordering with the full window, then the others against the bound they set
+    cilk_for(int i = 0; i < root.k; i++)
+        search_multipv_move(ctx, pos, depth, &root, i);
+    cilk_for(int i = root.k; i < nmoves; i++)
+        search_multipv_move(ctx, pos, depth, &root, i);
+
+    stable_sort(moves, moves + nmoves, root_move_better);
+    for (int i = 0; i < root.k; i++)
+        principal_variation(ctx, pos, &moves[i], depth);
+    return nmoves;
+}
+
+/*
+Solve the rest of the game exactly: a search as deep as there are empty squares.
+A win/loss/draw search with the window (-1, 1) comes first; it is much cheaper than
+the exact score and leaves bounds in the transposition table that speed up the
+exact search, which then only has to look on the winning (or losing) side of 0.
+*/
+Action solve_endgame(SearchContext *ctx, Board b, int color)
+{
+    int empties = board_empties(b);
+    Position pos = board_position(b, color);
+    Action action;
+    int square;
+    if (probe_cache(ctx, &pos, CACHE_SOLVED, &action.utility, &square))
+    {
+        action.move = square_move(square);
+        return action;
+    }
+    action = parallel_alphabeta(ctx, b, color, empties, 0, -1, 1, NULL);
+    if (action.utility > 0)
+        action = parallel_alphabeta(ctx, b, color, empties, 0, 0, 100, NULL);
+    else if (action.utility < 0)
+        action = parallel_alphabeta(ctx, b, color, empties, 0, -100, 0, NULL);
+    if (!is_stopped(ctx))
+        add_to_cache(ctx, &pos, CACHE_SOLVED, action.utility,
+                     action.move.row ? BOARD_BIT_INDEX(action.move.row, action.move.col) : 64);
+    return action;
+}
+
+/*
+Deepen `depth` = 1, 2, ... up to `max_depth` until the deadline passes or the
+search is stopped. Each iteration stores its best moves in the transposition table,
+where the next, deeper iteration finds them and searches them first. The result of
+an iteration cut short is thrown away, so the returned action always comes from a
+completed search; `depth_reached` is the depth of that search. `color` must have a
+legal move.
+*/
+Action deepen(SearchContext *ctx, Board b, int color, int max_depth, int *depth_reached)
+{
+    ull legal_moves = bb_kernel.legal_moves(b.disks[color], b.disks[OTHERCOLOR(color)]);
+    int empties = board_empties(b);
+
+    // Until the first iteration finishes, fall back to the first legal move
+    Action best_action;
+    int first_square = bb_first_square(legal_moves);
+    best_action.move.row = BB_SQUARE_ROW(first_square);
+    best_action.move.col = BB_SQUARE_COL(first_square);
+    best_action.utility = 0;
+    *depth_reached = 0;
+
+    for (int depth = 1; depth <= max_depth; depth++)
+    {
+        Action action = parallel_alphabeta(ctx, b, color, depth, 0, -100, 100, NULL);
+        if (is_stopped(ctx))
+            break;
+        best_action = action;
+        *depth_reached = depth;
+        // Searching past the last empty square cannot change the result
+        if (depth >= empties)
+            break;
+    }
+    return best_action;
+}
+
+// Search `depth` = 1, 2, ... (see deepen) until `budget` seconds are spent or `max_depth` is reached
+Action iterative_deepening(SearchContext *ctx, Board b, int color, int max_depth, double budget, int *depth_reached)
+{
+    ctx->timed_out = false;
+    ctx->deadline = now_seconds() + budget;
+    Action best_action = deepen(ctx, b, color, max_depth, depth_reached);
+    ctx->deadline = 0;
+    ctx->timed_out = false;
+    return best_action;
+}
+
+/*
+Search the move of `color` in `b` within `limits` into `result` (see Engine::search).
+A side without a move passes and the position is searched for the opponent. While
+a deadline shared by several positions runs (Engine::analyze), a timed position
+deepens until it, even near the end of the game; a timed search of its own solves
+the endgame first and only deepens on its own budget before that.
+*/
+void search_position(SearchContext *ctx, Board b, int color, const SearchLimits *limits, SearchResult *result)
+{
+    int mover = color;
+    int engine = (limits->engine == ENGINE_DEFAULT) ? ctx->config.engine : limits->engine;
+    int empties = board_empties(b);
+    int book_depth;
+    result->action.move.row = 0;
+    result->exact = false;
+    result->lines.clear();
+    if (bb_kernel.legal_moves(b.disks[mover], b.disks[OTHERCOLOR(mover)]) == 0)
+    {
+        mover = OTHERCOLOR(color);
+        if (bb_kernel.legal_moves(b.disks[mover], b.disks[OTHERCOLOR(mover)]) == 0)
+        {
+            result->action.utility = bb_popcount(b.disks[color]) - bb_popcount(b.disks[OTHERCOLOR(color)]);
+            result->depth = 0;
+            result->exact = true;
+            result->source = SEARCH_OVER;
+            return;
+        }
+    }
+
+    if (book_move(ctx, b, mover, &result->action, &book_depth))
+    {
+        result->depth = book_depth;
+        result->source = SEARCH_BOOK;
+    }
+    else if (limits->move_time > 0 && ctx->deadline > 0)
+    {
+        result->action = deepen(ctx, b, mover, limits->depth, &result->depth);
+        result->source = SEARCH_TIMED;
+    }
+    else if (limits->multipv > 0 && limits->move_time == 0 && mover == color)
+    {
+        // An endgame is ranked to the end of the game, like it is solved otherwise
+        result->depth = (empties <= ctx->config.endgame_empties) ? empties : limits->depth;
+        result->lines.resize(STACK_MAX_MOVES);
+        int nmoves = multi_pv(ctx, b, mover, result->depth, limits->multipv, result->lines.data());
+        result->lines.resize(nmoves < limits->multipv ? nmoves : limits->multipv);
+        result->action.move = square_move(result->lines[0].square);
+        result->action.utility = result->lines[0].score;
+        result->source = SEARCH_RANKED;
+    }
+    else if (empties <= ctx->config.endgame_empties)
+    {
+        result->action = solve_endgame(ctx, b, mover);
+        result->depth = empties;
+        result->source = SEARCH_SOLVED;
+    }
+    else if (limits->move_time > 0)
+    {
+        // Time-controlled: the depth only caps the iterative deepening
+        result->action = iterative_deepening(ctx, b, mover, limits->depth, limits->move_time, &result->depth);
+        result->source = SEARCH_TIMED;
+    }
+    else
+    {
+        result->action = engine_search(ctx, engine, b, mover, limits->depth);
+        result->depth = limits->depth;
+        result->source = SEARCH_FIXED;
+    }
+    result->exact = result->depth >= empties;
+
+    if (mover != color)
+    {
+        result->action.move.row = 0;
+        result->action.utility = -result->action.utility;
+    }
+}
+
+/*
+Start a search: the killers and the counters start over, and with a `new_generation`
+the table ages (or is cleared with fresh_search); a ponder search continues the last one.
+*/
+void begin_search(SearchContext *ctx, bool new_generation)
+{
+    if (new_generation && ctx->config.fresh_search)
+        tt_clear(&ctx->tt);
+    else if (new_generation)
+        tt_new_search(&ctx->tt);
+    ordering_new_search(&ctx->ordering);
+    stats_clear(ctx->stats);
+    reset_nodes(ctx);
+}
+
+// Collect the counters of the search into `result`, then tune the grain for the next one
+void end_search(SearchContext *ctx, SearchResult *result)
+{
+    result->nodes = total_nodes(ctx);
+    result->ordering = ordering_stats(&ctx->ordering);
+    stats_merge(ctx->stats, &result->stats);
+    grain_counts(&ctx->grain, &result->children, &result->stolen);
+    result->grain = ctx->grain.min_nodes;
+    grain_adapt(&ctx->grain);
+}
+
+// The move generation kernel and the hash keys of every search in the process (see ENGINE_LIBRARY)
+BitboardKernel bb_kernel = {"scalar", bb_legal_moves_scalar, bb_flip_mask_scalar};
+ZobristKeys zobrist;
+
+static bool select_kernel_and_keys()
+{
+    bb_select_kernel(getenv("OTHELLO_SIMD"));
+    zobrist_init();
+    return true;
+}
+
+void engine_library_init()
+{
+    static bool initialized = select_kernel_and_keys();
+    (void)initialized;
+}
+
+Engine::Engine(const EngineConfig &config)
+{
+    engine_library_init();
+    // The per-worker counters are aligned to cache lines, which plain new does not guarantee before C++17
+    void *memory;
+    if (posix_memalign(&memory, 64, sizeof(SearchContext)) != 0)
+    {
+        fprintf(stderr, "cannot allocate the search state of an engine\n");
+        exit(1);
+    }
+    context = new (memory) SearchContext();
+    context->config = config;
+    tt_init(&context->tt, config.table_megabytes);
+    ordering_init(&context->ordering, config.ordering);
+    grain_init(&context->grain, config.grain_policy, config.grain_nodes, __cilkrts_get_nworkers());
+    context->negamax_kernels = true;
+    context->deadline = 0;
+    context->timed_out = false;
+    context->stopped = false;
+    board.disks[X_BLACK] = BOARD_BIT(4, 5) | BOARD_BIT(5, 4);
+    board.disks[O_WHITE] = BOARD_BIT(4, 4) | BOARD_BIT(5, 5);
+    color = X_BLACK;
+}
+
+Engine::~Engine()
+{
+    tt_init(&context->tt, 0);
+    context->~SearchContext();
+    free(context);
+}
+
+void Engine::set_position(Board b, int color)
+{
+    board = b;
+    this->color = color;
+}
+
+// Engine::search, or Engine::ponder without a `new_generation` of the table
+static SearchResult search_engine_position(SearchContext *ctx, Board b, int color, const SearchLimits &limits, bool new_generation)
+{
+    SearchResult result = SearchResult();
+    begin_search(ctx, new_generation);
+    double begin = now_seconds();
+    search_position(ctx, b, color, &limits, &result);
+    result.seconds = now_seconds() - begin;
+    end_search(ctx, &result);
+    return result;
+}
+
+SearchResult Engine::search(const SearchLimits &limits)
+{
+    return search_engine_position(context, board, color, limits, true);
+}
+
+SearchResult Engine::ponder(const SearchLimits &limits)
+{
+    return search_engine_position(context, board, color, limits, false);
+}
+
+ull Engine::analyze(Analysis *positions, int n, const SearchLimits &limits)
+{
+    begin_search(context, true);
+    if (limits.move_time > 0)
+    {
+        context->timed_out = false;
+        context->deadline = now_seconds() + limits.move_time;
+    }
+    cilk_for(int i = 0; i < n; i++)
+    {
+        Analysis *a = &positions[i];
+        double begin = now_seconds();
+        a->result = SearchResult();
+        search_position(context, a->board, a->color, &limits, &a->result);
+        a->result.seconds = now_seconds() - begin;
+    }
+    context->deadline = 0;
+    context->timed_out = false;
+    ull nodes = total_nodes(context);
+    grain_adapt(&context->grain);
+    return nodes;
+}
+
+int Engine::ordered_moves(Board b, int color, unsigned char *squares)
+{
+    Position pos = board_position(b, color);
+    ordering_new_search(&context->ordering);
+    return get_ordered_squares(context, &pos, position_legal_moves(&pos), 0, ORDER_NO_SQUARE, squares);
+}
+
+void Engine::stop()
+{
+    context->stopped = true;
+}
+
+void Engine::resume()
+{
+    context->stopped = false;
+}
+
+void Engine::new_game()
+{
+    tt_clear(&context->tt);
+    ordering_init(&context->ordering, context->config.ordering);
+    grain_init(&context->grain, context->config.grain_policy, context->config.grain_nodes, __cilkrts_get_nworkers());
+    reset_nodes(context);
+}
+
+const EngineConfig &Engine::config() const
+{
+    return context->config;
+}
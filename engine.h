@@ -0,0 +1,278 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+/* the move generation kernel and the hash keys are the library's, see engine_library_init */
+#define ENGINE_LIBRARY
+
+#include <time.h>
+#include <vector>
+#include "bitboard_simd.h"
+#include "transposition.h"
+#include "ordering.h"
+#include "endgame.h"
+#include "stats.h"
+#include "grain.h"
+#include "search_stack.h"
+#include "book.h"
+#include "cache.h"
+
+#if !defined(BB_KERNEL_SHARED) || !defined(TT_ZOBRIST_SHARED)
+#error "include engine.h before the other headers of the search"
+#endif
+
+/*
+the search engine as a library: no console I/O and no global search state.
+
+an Engine owns everything a search writes (transposition table, move ordering,
+grain control, node and statistics counters, time control), so several engines
+can search at the same time in one process. they all run on the one Cilk worker
+pool of the process: their strands are spawned into it like those of any other
+search, and the serial searches below them borrow the per-worker search stacks
+(search_stack.h), which is safe since a serial search never spawns and runs to
+completion on its worker before the worker takes anything else.
+
+    EngineConfig config = engine_default_config();
+    config.endgame_empties = 12;
+    Engine engine(config);
+    engine.set_position(board, X_BLACK);
+    SearchLimits limits = {10, 0.5, ENGINE_DEFAULT, 0};
+    SearchResult result = engine.search(limits);
+
+one engine runs one search at a time: search() and analyze() must not be called
+on it concurrently. analyze() searches many positions in parallel on the engine's
+table instead. a PositionCache may be shared by engines but must only be merged
+(cache.h) while none of them searches.
+*/
+
+#define X_BLACK 0
+#define O_WHITE 1
+#define OTHERCOLOR(c) (1 - (c))
+
+/*
+represent game board squares as a 64-bit unsigned integer.
+these macros index from a row,column position on the board
+to a position and bit in a game board bitvector
+*/
+#define BOARD_BIT_INDEX(row, col) ((8 - (row)) * 8 + (8 - (col)))
+#define BOARD_BIT(row, col) (0x1ULL << BOARD_BIT_INDEX(row, col))
+#define MOVE_TO_BOARD_BIT(m) BOARD_BIT(m.row, m.col)
+
+/*
+game board represented as a pair of bit vectors:
+    - one for x_black disks on the board
+    - one for o_white disks on the board
+*/
+typedef struct
+{
+    ull disks[2];
+} Board;
+
+typedef struct
+{
+    int row;
+    int col;
+} Move;
+
+typedef struct
+{
+    int utility;
+    Move move;
+} Action;
+
+// Search of the moves to a fixed depth
+#define ENGINE_DEFAULT -1             /* the engine of the configuration */
+#define ENGINE_ALPHABETA 0            /* parallel_alphabeta: Young Brothers Wait with PVS windows */
+#define ENGINE_NEGAMAX 1              /* parallel_negamax: full-width search, no pruning */
+#define ENGINE_LAZY_SMP 2             /* lazy_smp: one serial alpha-beta search per worker, sharing the table */
+#define ENGINE_SERIAL_NEGAMAX 3       /* serial_negamax, for the benchmark */
+#define ENGINE_SERIAL_NEGAMAX_GENERIC 4 /* serial_negamax without the specialized kernels, for the benchmark */
+
+// How a search found its move
+#define SEARCH_FIXED 0  /* a search to the depth of the limits */
+#define SEARCH_TIMED 1  /* iterative deepening until the time of the limits was spent */
+#define SEARCH_SOLVED 2 /* the endgame solved to the end of the game */
+#define SEARCH_BOOK 3   /* the opening book, without a search */
+#define SEARCH_RANKED 4 /* the best root moves ranked with multi-PV */
+#define SEARCH_OVER 5   /* neither side has a move */
+
+/* rank every root move (SearchLimits.multipv) */
+#define MULTIPV_ALL STACK_MAX_MOVES
+#define MULTIPV_MAX_PLIES 64
+#define MULTIPV_PASS 64 /* a pass in a principal variation */
+
+typedef struct
+{
+    int square;
+    int score;
+    bool exact; /* false if `score` is only an upper bound: the move is not among the best k */
+    int npv;
+    unsigned char pv[MULTIPV_MAX_PLIES]; /* the move itself, then the best replies */
+} RootMove;
+
+typedef struct
+{
+    int engine;              /* ENGINE_* of the searches to a fixed depth */
+    size_t table_megabytes;  /* transposition table, 0 disables it */
+    unsigned ordering;       /* move ordering heuristics, see ordering.h */
+    int grain_policy;        /* grain size control, see grain.h */
+    double grain_nodes;
+    int endgame_empties;     /* solve the game exactly from this many empty squares on, 0 never */
+    bool fresh_search;       /* clear the table before every search instead of letting it age */
+    const OpeningBook *book; /* played before any search, NULL for none */
+    PositionCache *cache;    /* exact results kept across runs, NULL for none */
+} EngineConfig;
+
+typedef struct
+{
+    int depth;        /* moves ahead; the maximum depth of the iterative deepening when timed */
+    double move_time; /* seconds per position, 0 searches to `depth` */
+    int engine;       /* ENGINE_* or ENGINE_DEFAULT */
+    int multipv;      /* rank this many root moves (MULTIPV_ALL for all) to `depth`, 0 for the best move only; a timed search (move_time > 0) ignores it */
+} SearchLimits;
+
+typedef struct
+{
+    Action action;  /* move row 0 if the side to move has to pass (the score is still its own) */
+    int depth;      /* of the search that chose the move, 0 if the game is over */
+    bool exact;     /* the score is the final disk differential with best play */
+    int source;     /* SEARCH_* */
+    ull nodes;      /* positions searched, 0 for each position of analyze() */
+    double seconds;
+    OrderingStats ordering;
+    SearchStats stats; /* merged over the workers, all zero with -DNO_SEARCH_STATS */
+    ull children;      /* spawned by the parallel searches */
+    ull stolen;        /* ... and run on another worker than their parent */
+    double grain;      /* grain of the parallel searches, in nodes */
+    std::vector<RootMove> lines; /* with SearchLimits.multipv, the best moves, best first */
+} SearchResult;
+
+// A position searched by Engine::analyze
+typedef struct
+{
+    Board board;
+    int color;
+    SearchResult result;
+} Analysis;
+
+static inline EngineConfig engine_default_config()
+{
+    EngineConfig config;
+    config.engine = ENGINE_ALPHABETA;
+    config.table_megabytes = TT_DEFAULT_MEGABYTES;
+    config.ordering = ORDER_DEFAULT;
+    config.grain_policy = GRAIN_ADAPTIVE;
+    config.grain_nodes = GRAIN_DEFAULT_NODES;
+    config.endgame_empties = ENDGAME_DEFAULT_EMPTIES;
+    config.fresh_search = false;
+    config.book = NULL;
+    config.cache = NULL;
+    return config;
+}
+
+class Engine
+{
+public:
+    explicit Engine(const EngineConfig &config);
+    ~Engine();
+
+    void set_position(Board b, int color);
+
+    /*
+    search the move of the position: from the opening book, an exact solve near
+    the end of the game, iterative deepening when the limits give a time, or a
+    search of the engine to the fixed depth. a side without a move passes and the
+    position is searched for the opponent.
+    */
+    SearchResult search(const SearchLimits &limits);
+
+    /*
+    search() as a continuation of the last search, for pondering: the table keeps
+    the generation of that search (and is not cleared with fresh_search), so any
+    number of ponder searches between two moves age it by no more than one.
+    */
+    SearchResult ponder(const SearchLimits &limits);
+
+    /*
+    search `n` positions at once, one strand each, with the same limits; timed
+    positions all deepen until the same deadline. return the nodes searched.
+    */
+    ull analyze(Analysis *positions, int n, const SearchLimits &limits);
+
+    // The legal moves of `color` in `b` into `squares`, the most promising first; return how many there are
+    int ordered_moves(Board b, int color, unsigned char *squares);
+
+    /*
+    cut the running search short, from another strand or thread: it returns as soon
+    as it can, with a meaningless result. the engine stays stopped, and any search
+    returns at once, until resume().
+    */
+    void stop();
+    void resume();
+
+    // Forget everything learned: empty table, fresh move ordering and grain, as a new engine
+    void new_game();
+
+    const EngineConfig &config() const;
+
+private:
+    struct SearchContext *context;
+    Board board;
+    int color;
+
+    Engine(const Engine &);
+    Engine &operator=(const Engine &);
+};
+
+/*
+pick the move generation kernel (OTHELLO_SIMD=scalar|lines|avx2|avx512, the fastest
+the CPU supports by default) and the hash keys, once per process. the Engine
+constructor calls it; a program that plays moves with the helpers below before it
+creates an engine calls it first.
+*/
+void engine_library_init();
+
+// Parse an engine name: alphabeta, negamax or lazysmp; false on anything else
+bool parse_engine(const char *text, int *engine);
+
+/*
+parse a position in the text format (64 squares, then the side to move) at the
+start of `text`. return a pointer just past the side to move, or NULL if `text`
+does not start with a position.
+*/
+const char *parse_position(const char *text, Board *b, int *color);
+
+// Move on square `sq`; row 0 (no move) for a square past the board such as ORDER_NO_SQUARE or TT_NO_MOVE
+static inline Move square_move(int sq)
+{
+    Move move = {0, 0};
+    if (sq < 64)
+    {
+        move.row = BB_SQUARE_ROW(sq);
+        move.col = BB_SQUARE_COL(sq);
+    }
+    return move;
+}
+
+// Place a `color` disk on square `sq` and return the disks it flipped
+static inline ull play_square(Board *b, int sq, int color)
+{
+    ull flips = bb_kernel.flip_mask(sq, b->disks[color], b->disks[OTHERCOLOR(color)]);
+    b->disks[color] |= flips | BB_SQUARE_BIT(sq);
+    b->disks[OTHERCOLOR(color)] &= ~flips;
+    return flips;
+}
+
+// CLOCK_MONOTONIC seconds
+static inline double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline int board_empties(Board b)
+{
+    return 64 - bb_popcount(b.disks[X_BLACK] | b.disks[O_WHITE]);
+}
+
+#endif
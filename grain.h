@@ -0,0 +1,146 @@
+#ifndef GRAIN_H
+#define GRAIN_H
+
+#include <string.h>
+#include <stdlib.h>
+
+/*
+grain size control: when a parallel search stops spawning and hands a subtree
+to its serial counterpart.
+
+the original rule serialized every node with depth <= 3, the same in a position
+with 2 legal moves as in one with 15, and the same on 1 worker as on 16. the
+adaptive policy instead estimates the size of the subtree from the mobility of
+the node and the remaining depth:
+    full-width search:  mobility ^ depth
+    alpha-beta search:  sqrt(mobility) ^ depth  (the minimal tree)
+and searches the node serially when the estimate is below a grain of
+`min_nodes`. on 1 worker nothing is spawned at all.
+
+the grain is tuned between moves from the steal rate: the share of spawned
+children that ended up on a different worker than the node that spawned them.
+few steals mean the spawns were mostly overhead, so the grain grows; many
+steals mean workers were idle and went looking for work, so it shrinks.
+*/
+
+typedef unsigned long long ull;
+
+#define GRAIN_FIXED 0    /* depth <= GRAIN_FIXED_DEPTH, the original rule */
+#define GRAIN_ADAPTIVE 1 /* subtree estimate, tuned from the steal rate */
+#define GRAIN_NODES 2    /* subtree estimate against a constant grain */
+
+#define GRAIN_FIXED_DEPTH 3
+#define GRAIN_DEFAULT_NODES 2048.0
+#define GRAIN_MIN_NODES 16.0
+#define GRAIN_MAX_NODES 1e12
+
+/* steal rates outside this band move the grain by a factor of 2 */
+#define GRAIN_LOW_STEAL_RATE 0.02
+#define GRAIN_HIGH_STEAL_RATE 0.20
+
+#define GRAIN_MAX_WORKERS 64
+
+typedef struct alignas(64)
+{
+    ull children; /* spawned children this worker ran */
+    ull stolen;   /* ... for a node that started on another worker */
+} GrainWorker;
+
+typedef struct
+{
+    int policy;
+    int nworkers;
+    double min_nodes; /* subtrees estimated smaller than this are searched serially */
+    GrainWorker workers[GRAIN_MAX_WORKERS];
+} GrainControl;
+
+static inline void grain_clear_counts(GrainControl *g)
+{
+    memset((void *)g->workers, 0, sizeof(g->workers));
+}
+
+// Start from the default grain on `nworkers` workers; GRAIN_NODES keeps the `min_nodes` it was given
+static inline void grain_init(GrainControl *g, int policy, double min_nodes, int nworkers)
+{
+    g->policy = policy;
+    g->nworkers = nworkers;
+    g->min_nodes = (policy == GRAIN_NODES) ? min_nodes : GRAIN_DEFAULT_NODES;
+    grain_clear_counts(g);
+}
+
+/*
+parse "fixed", "adaptive" or a number of nodes (a constant grain).
+returns false on anything else.
+*/
+static inline bool grain_parse_policy(const char *text, int *policy, double *min_nodes)
+{
+    char *end;
+    if (strcmp(text, "fixed") == 0)
+        *policy = GRAIN_FIXED;
+    else if (strcmp(text, "adaptive") == 0)
+        *policy = GRAIN_ADAPTIVE;
+    else if ((*min_nodes = strtod(text, &end)) > 0 && *end == '\0')
+        *policy = GRAIN_NODES;
+    else
+        return false;
+    return true;
+}
+
+// Estimated number of nodes below a node with `mobility` legal moves and `depth` moves left
+static inline double grain_estimate(int mobility, int depth, bool pruning)
+{
+    double branching = (mobility > 1) ? mobility : 1;
+    if (pruning)
+        branching = __builtin_sqrt(branching);
+    double nodes = 1;
+    for (int d = 0; d < depth && nodes < GRAIN_MAX_NODES; d++)
+        nodes *= branching;
+    return nodes;
+}
+
+// Return true if a node with `mobility` legal moves and `depth` moves left should be searched serially
+static inline bool grain_serial(const GrainControl *g, int mobility, int depth, bool pruning)
+{
+    if (g->policy == GRAIN_FIXED)
+        return depth <= GRAIN_FIXED_DEPTH;
+    if (g->nworkers <= 1 || depth <= 1)
+        return true;
+    return grain_estimate(mobility, depth, pruning) < g->min_nodes;
+}
+
+// Count a spawned child of a node that started on worker `home`, now running on worker `worker`
+static inline void grain_count_child(GrainControl *g, int home, int worker)
+{
+    GrainWorker *w = &g->workers[worker % GRAIN_MAX_WORKERS];
+    w->children++;
+    if (worker != home)
+        w->stolen++;
+}
+
+static inline void grain_counts(const GrainControl *g, ull *children, ull *stolen)
+{
+    *children = *stolen = 0;
+    for (int w = 0; w < GRAIN_MAX_WORKERS; w++)
+    {
+        *children += g->workers[w].children;
+        *stolen += g->workers[w].stolen;
+    }
+}
+
+// After a search: move the adaptive grain by the steal rate observed, then reset the counts
+static inline void grain_adapt(GrainControl *g)
+{
+    ull children, stolen;
+    grain_counts(g, &children, &stolen);
+    if (g->policy == GRAIN_ADAPTIVE && children > 0)
+    {
+        double rate = (double)stolen / children;
+        if (rate < GRAIN_LOW_STEAL_RATE && g->min_nodes * 2 <= GRAIN_MAX_NODES)
+            g->min_nodes *= 2;
+        else if (rate > GRAIN_HIGH_STEAL_RATE && g->min_nodes / 2 >= GRAIN_MIN_NODES)
+            g->min_nodes /= 2;
+    }
+    grain_clear_counts(g);
+}
+
+#endif
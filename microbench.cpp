@@ -0,0 +1,229 @@
+/*
+Microbenchmark for the move generation kernels in bitboard_simd.h.
+
+A fixed set of positions is produced by seeded random playouts from the
+initial board. For every kernel the benchmark times one "node": the legal
+move set of the side to move plus the flip mask of each of its legal moves,
+which is what the search does at every interior node. Results of every
+kernel are checked against the scalar kernel before timing.
+
+A second table times the flip engines alone, per legal move: the recursive
+ray walk of TryFlips in the game programs, and the flip mask of every kernel
+(shift fills, SIMD fills and the line lookup tables of bitboard_lines.h).
+
+usage: ./microbench [repetitions]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "bitboard_simd.h"
+using namespace std;
+
+typedef struct
+{
+    ull own;
+    ull opp;
+} Position;
+
+static ull rng_state = 0x9e3779b97f4a7c15ULL;
+
+static ull next_random()
+{
+    ull z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Play random games from the initial board and record every position with a legal move
+static vector<Position> make_positions(int ngames)
+{
+    vector<Position> positions;
+    for (int g = 0; g < ngames; g++)
+    {
+        // X_BLACK moves first: (4, 5) and (5, 4) are black, (4, 4) and (5, 5) white
+        ull own = (1ULL << 28) | (1ULL << 35), opp = (1ULL << 27) | (1ULL << 36);
+        int passes = 0;
+        while (passes < 2)
+        {
+            ull moves = bb_legal_moves(own, opp);
+            if (moves)
+            {
+                Position p = {own, opp};
+                positions.push_back(p);
+                int pick = next_random() % bb_popcount(moves);
+                for (; pick > 0; pick--)
+                    moves &= moves - 1;
+                int sq = bb_first_square(moves);
+                ull flips = bb_flip_mask(sq, own, opp);
+                own |= flips | BB_SQUARE_BIT(sq);
+                opp &= ~flips;
+                passes = 0;
+            }
+            else
+                passes++;
+            ull t = own;
+            own = opp;
+            opp = t;
+        }
+    }
+    return positions;
+}
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+the recursive walk of TryFlips/FlipDisks in the game programs, on bitboards: step one
+square at a time along a direction; a run of opponent disks flips if an own disk ends it
+*/
+static const int ray_steps[8][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}, {-1, -1}, {-1, 1}, {1, 1}, {1, -1}};
+
+static int ray_flips(int row, int col, int drow, int dcol, ull own, ull opp, ull *flips)
+{
+    row += drow;
+    col += dcol;
+    if (row < 1 || row > 8 || col < 1 || col > 8)
+        return 0;
+    ull bit = 1ULL << ((8 - row) * 8 + (8 - col));
+    if (bit & opp)
+    {
+        int nflips = ray_flips(row, col, drow, dcol, own, opp, flips);
+        if (nflips)
+        {
+            *flips |= bit;
+            return nflips + 1;
+        }
+    }
+    else if (bit & own)
+        return 1;
+    return 0;
+}
+
+static ull flip_mask_recursive(int sq, ull own, ull opp)
+{
+    ull flips = 0;
+    for (int d = 0; d < 8; d++)
+        ray_flips(BB_SQUARE_ROW(sq), BB_SQUARE_COL(sq), ray_steps[d][0], ray_steps[d][1], own, opp, &flips);
+    return flips;
+}
+
+// Combine every kernel result into a checksum so the work cannot be optimized away
+static ull run_nodes(const BitboardKernel *k, const vector<Position> &positions)
+{
+    ull checksum = 0;
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        ull moves = k->legal_moves(positions[i].own, positions[i].opp);
+        checksum += moves;
+        for (; moves; moves &= moves - 1)
+            checksum ^= k->flip_mask(bb_first_square(moves), positions[i].own, positions[i].opp);
+    }
+    return checksum;
+}
+
+// Flip masks of every legal move of every position; `nmoves` receives how many there were
+static ull run_flips(bb_flip_mask_fn flip_mask, const vector<Position> &positions, long *nmoves)
+{
+    ull checksum = 0;
+    *nmoves = 0;
+    for (size_t i = 0; i < positions.size(); i++)
+        for (ull moves = bb_legal_moves(positions[i].own, positions[i].opp); moves; moves &= moves - 1)
+        {
+            checksum ^= flip_mask(bb_first_square(moves), positions[i].own, positions[i].opp) + checksum;
+            (*nmoves)++;
+        }
+    return checksum;
+}
+
+// The kernels from the slowest to the fastest: scalar first, the baseline of the speedups
+static vector<const BitboardKernel *> kernels_in_order()
+{
+    vector<const BitboardKernel *> order;
+    for (int i = 0; i < bb_nkernels; i++)
+        if (strcmp(bb_kernels[i].name, "scalar") == 0)
+            order.push_back(&bb_kernels[i]);
+    for (int i = bb_nkernels - 1; i >= 0; i--)
+        if (strcmp(bb_kernels[i].name, "scalar") != 0)
+            order.push_back(&bb_kernels[i]);
+    return order;
+}
+
+// Time the flip engines per legal move, the recursive walk first; return false if one of them is wrong
+static bool run_flip_engines(const vector<Position> &positions, int reps)
+{
+    long nmoves;
+    ull expected = run_flips(flip_mask_recursive, positions, &nmoves);
+    double recursive_ns = 0;
+    vector<const BitboardKernel *> kernels = kernels_in_order();
+    printf("\n%-9s %11s %10s\n", "flips", "ns/move", "speedup");
+    for (int i = -1; i < (int)kernels.size(); i++)
+    {
+        const char *name = (i < 0) ? "recursive" : kernels[i]->name;
+        bb_flip_mask_fn flip_mask = (i < 0) ? flip_mask_recursive : kernels[i]->flip_mask;
+        if (i >= 0 && !bb_kernel_supported(kernels[i]))
+        {
+            printf("%-9s %11s\n", name, "unsupported");
+            continue;
+        }
+        if (run_flips(flip_mask, positions, &nmoves) != expected)
+        {
+            printf("%-9s results differ from the recursive walk\n", name);
+            return false;
+        }
+        double begin = now_seconds();
+        ull checksum = 0;
+        for (int r = 0; r < reps; r++)
+            checksum += run_flips(flip_mask, positions, &nmoves);
+        double ns = (now_seconds() - begin) * 1e9 / ((double)reps * nmoves);
+        if (i < 0)
+            recursive_ns = ns;
+        printf("%-9s %11.2f %9.2fx\n", name, ns, recursive_ns / ns);
+        if (checksum == 0)
+            printf("\n");
+    }
+    return true;
+}
+
+int main(int argc, const char *argv[])
+{
+    int reps = (argc > 1) ? atoi(argv[1]) : 50;
+    vector<Position> positions = make_positions(200);
+    printf("%zu positions, %d repetitions\n", positions.size(), reps);
+
+    vector<const BitboardKernel *> kernels = kernels_in_order();
+    const BitboardKernel *scalar = kernels[0];
+    ull expected = run_nodes(scalar, positions);
+    double scalar_ns = 0;
+    printf("%-8s %12s %10s\n", "kernel", "ns/node", "speedup");
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        const BitboardKernel *k = kernels[i];
+        if (!bb_kernel_supported(k))
+        {
+            printf("%-8s %12s\n", k->name, "unsupported");
+            continue;
+        }
+        if (run_nodes(k, positions) != expected)
+        {
+            printf("%-8s results differ from the scalar kernel\n", k->name);
+            return 1;
+        }
+        double begin = now_seconds();
+        ull checksum = 0;
+        for (int r = 0; r < reps; r++)
+            checksum += run_nodes(k, positions);
+        double ns = (now_seconds() - begin) * 1e9 / ((double)reps * positions.size());
+        if (k == scalar)
+            scalar_ns = ns;
+        printf("%-8s %12.2f %9.2fx\n", k->name, ns, scalar_ns / ns);
+        if (checksum == 0)
+            printf("\n");
+    }
+    return run_flip_engines(positions, reps) ? 0 : 1;
+}
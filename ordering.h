@@ -0,0 +1,246 @@
+#ifndef ORDERING_H
+#define ORDERING_H
+
+#include <string.h>
+#include "bitboard_simd.h"
+
+/*
+move ordering stage between move generation and the alpha-beta search loop.
+
+alpha-beta prunes the most when the best move is searched first, so the legal
+moves of a node are sorted by a priority built from these heuristics (each
+one can be switched on and off with the policy bits):
+    - hash move:   the best move stored in the transposition table
+    - killers:     the last two moves that caused a cutoff at the same ply
+    - history:     how often (weighted by depth^2) a square caused a cutoff
+    - static:      a fixed table of square values (corners good, X-squares bad)
+    - mobility:    "fastest first", moves leaving the opponent fewer replies
+hash move and killers are tried before everything else; the other heuristics
+are added together to rank the remaining moves. equal moves keep the scan
+order of the move generator.
+
+killers, history and the cutoff statistics are kept per worker so that
+workers never write to the same cache lines; the history can instead be
+shared by every worker (ORDER_SHARED_HISTORY), trading those benign races
+for a table that learns from the whole search.
+*/
+
+typedef unsigned long long ull;
+
+#define ORDER_HASH 0x01
+#define ORDER_KILLERS 0x02
+#define ORDER_HISTORY 0x04
+#define ORDER_STATIC 0x08
+#define ORDER_MOBILITY 0x10
+#define ORDER_SHARED_HISTORY 0x20
+#define ORDER_DEFAULT (ORDER_HASH | ORDER_KILLERS | ORDER_HISTORY | ORDER_STATIC)
+
+#define ORDER_MAX_PLY 64
+#define ORDER_MAX_WORKERS 64
+#define ORDER_NO_SQUARE 0xff
+
+/* history counters are halved once one of them passes this value */
+#define ORDER_HISTORY_LIMIT (1 << 14)
+
+/* weights of the additive heuristics */
+#define ORDER_STATIC_WEIGHT 64
+#define ORDER_MOBILITY_WEIGHT 512
+
+/* priorities of the moves that are tried before everything else */
+#define ORDER_HASH_PRIORITY (1 << 30)
+#define ORDER_KILLER_PRIORITY (1 << 29)
+
+/*
+square values indexed by bit index (bit 0 is row 8, column 8). the board is
+symmetric, so this reads the same as a row 1..8, column 1..8 table.
+*/
+static const int order_square_values[64] = {
+    100, -20, 10, 5, 5, 10, -20, 100,
+    -20, -50, -2, -2, -2, -2, -50, -20,
+    10, -2, -1, -1, -1, -1, -2, 10,
+    5, -2, -1, -1, -1, -1, -2, 5,
+    5, -2, -1, -1, -1, -1, -2, 5,
+    10, -2, -1, -1, -1, -1, -2, 10,
+    -20, -50, -2, -2, -2, -2, -50, -20,
+    100, -20, 10, 5, 5, 10, -20, 100};
+
+typedef struct
+{
+    ull nodes;              /* interior nodes whose moves were ordered */
+    ull cutoffs;            /* nodes that failed high */
+    ull first_move_cutoffs; /* ... on the first move searched */
+} OrderingStats;
+
+typedef struct alignas(64)
+{
+    unsigned char killers[ORDER_MAX_PLY][2];
+    int history[2][64];
+    OrderingStats stats;
+} OrderingWorker;
+
+typedef struct
+{
+    unsigned policy;
+    OrderingWorker workers[ORDER_MAX_WORKERS];
+} MoveOrdering;
+
+static inline void ordering_clear(MoveOrdering *mo)
+{
+    for (int w = 0; w < ORDER_MAX_WORKERS; w++)
+    {
+        memset(mo->workers[w].killers, ORDER_NO_SQUARE, sizeof(mo->workers[w].killers));
+        memset(mo->workers[w].history, 0, sizeof(mo->workers[w].history));
+        memset(&mo->workers[w].stats, 0, sizeof(OrderingStats));
+    }
+}
+
+/* start the search of a new root position: killers and statistics are per search, history is kept */
+static inline void ordering_new_search(MoveOrdering *mo)
+{
+    for (int w = 0; w < ORDER_MAX_WORKERS; w++)
+    {
+        memset(mo->workers[w].killers, ORDER_NO_SQUARE, sizeof(mo->workers[w].killers));
+        memset(&mo->workers[w].stats, 0, sizeof(OrderingStats));
+    }
+}
+
+static inline void ordering_init(MoveOrdering *mo, unsigned policy)
+{
+    mo->policy = policy;
+    ordering_clear(mo);
+}
+
+/*
+parse a comma separated list of heuristics ("hash,killers,history,static,mobility,shared")
+or "none"/"default". returns false on an unknown name.
+*/
+static inline bool ordering_parse_policy(const char *text, unsigned *policy)
+{
+    static const struct
+    {
+        const char *name;
+        unsigned bits;
+    } names[] = {{"none", 0}, {"default", ORDER_DEFAULT}, {"hash", ORDER_HASH}, {"killers", ORDER_KILLERS}, {"history", ORDER_HISTORY}, {"static", ORDER_STATIC}, {"mobility", ORDER_MOBILITY}, {"shared", ORDER_HISTORY | ORDER_SHARED_HISTORY}};
+    *policy = 0;
+    while (*text)
+    {
+        size_t length = strcspn(text, ",");
+        bool found = false;
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        {
+            if (strlen(names[i].name) == length && strncmp(text, names[i].name, length) == 0)
+            {
+                *policy |= names[i].bits;
+                found = true;
+            }
+        }
+        if (!found)
+            return false;
+        text += length;
+        if (*text == ',')
+            text++;
+    }
+    return true;
+}
+
+// History counters of `color` used by `worker`
+static inline int *ordering_history(MoveOrdering *mo, int worker, int color)
+{
+    return (mo->policy & ORDER_SHARED_HISTORY) ? mo->workers[0].history[color] : mo->workers[worker].history[color];
+}
+
+/*
+write the legal moves `moves` of `color` (owning `own`, opponent `opp`) at `ply`
+into `squares`, best first, and return how many there are. `hash_square` is the
+transposition table move or ORDER_NO_SQUARE.
+*/
+static inline int order_moves(MoveOrdering *mo, int worker, int color, int ply, ull own, ull opp, ull moves,
+                              int hash_square, unsigned char *squares)
+{
+    OrderingWorker *w = &mo->workers[worker % ORDER_MAX_WORKERS];
+    unsigned policy = mo->policy;
+    const int *history = ordering_history(mo, worker % ORDER_MAX_WORKERS, color);
+    const unsigned char *killers = w->killers[(ply < ORDER_MAX_PLY) ? ply : ORDER_MAX_PLY - 1];
+    int priorities[64];
+    int n = 0;
+
+    w->stats.nodes++;
+    for (; moves; moves &= moves - 1)
+    {
+        int sq = bb_first_square(moves);
+        int priority = 0;
+        if ((policy & ORDER_HASH) && sq == hash_square)
+            priority = ORDER_HASH_PRIORITY;
+        else if ((policy & ORDER_KILLERS) && (sq == killers[0] || sq == killers[1]))
+            priority = ORDER_KILLER_PRIORITY + (sq == killers[0]);
+        else
+        {
+            if (policy & ORDER_HISTORY)
+                priority += history[sq];
+            if (policy & ORDER_STATIC)
+                priority += order_square_values[sq] * ORDER_STATIC_WEIGHT;
+            if (policy & ORDER_MOBILITY)
+            {
+                ull flips = bb_kernel.flip_mask(sq, own, opp);
+                ull replies = bb_kernel.legal_moves(opp & ~flips, own | flips | BB_SQUARE_BIT(sq));
+                priority -= bb_popcount(replies) * ORDER_MOBILITY_WEIGHT;
+            }
+        }
+
+        // insertion sort, equal priorities stay in generation order
+        int i = n++;
+        for (; i > 0 && priorities[i - 1] < priority; i--)
+        {
+            priorities[i] = priorities[i - 1];
+            squares[i] = squares[i - 1];
+        }
+        priorities[i] = priority;
+        squares[i] = (unsigned char)sq;
+    }
+    return n;
+}
+
+/*
+record that the move on `sq`, the `index`-th move searched at this node, caused a
+beta cutoff with `depth` moves left
+*/
+static inline void ordering_cutoff(MoveOrdering *mo, int worker, int color, int ply, int sq, int depth, int index)
+{
+    OrderingWorker *w = &mo->workers[worker % ORDER_MAX_WORKERS];
+    w->stats.cutoffs++;
+    if (index == 0)
+        w->stats.first_move_cutoffs++;
+
+    if (mo->policy & ORDER_KILLERS)
+    {
+        unsigned char *killers = w->killers[(ply < ORDER_MAX_PLY) ? ply : ORDER_MAX_PLY - 1];
+        if (killers[0] != sq)
+        {
+            killers[1] = killers[0];
+            killers[0] = (unsigned char)sq;
+        }
+    }
+    if (mo->policy & ORDER_HISTORY)
+    {
+        int *history = ordering_history(mo, worker % ORDER_MAX_WORKERS, color);
+        history[sq] += depth * depth;
+        if (history[sq] > ORDER_HISTORY_LIMIT)
+            for (int i = 0; i < 64; i++)
+                history[i] /= 2;
+    }
+}
+
+// Sum of the statistics of every worker
+static inline OrderingStats ordering_stats(const MoveOrdering *mo)
+{
+    OrderingStats total = {0, 0, 0};
+    for (int w = 0; w < ORDER_MAX_WORKERS; w++)
+    {
+        total.nodes += mo->workers[w].stats.nodes;
+        total.cutoffs += mo->workers[w].stats.cutoffs;
+        total.first_move_cutoffs += mo->workers[w].stats.first_move_cutoffs;
+    }
+    return total;
+}
+
+#endif
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "engine.h"
+using namespace std;
+
+/*
+synthetic load for the game server (othello-server.cpp): a number of sessions on
+one connection to the server's Unix domain socket, each playing the computer
+against itself from random openings, with one `go` outstanding per session at all
+times (a closed loop: a session asks for its next move as soon as it has the
+last). when a game ends, the session starts another one.
+
+after the given number of moves it reports the throughput (moves/sec) and the
+latency of a move from the client's side (from sending `go` to reading the move,
+p50, p99 and the maximum), then the server's own `stats`. a session the server
+answers with an `error` gets no move for its `go`, so it stops there; the run ends
+early if every session stopped.
+*/
+
+#define LOAD_DEFAULT_SESSIONS 16
+#define LOAD_DEFAULT_MOVES 2000
+#define LOAD_DEFAULT_RANDOM_PLIES 8
+#define LOAD_MAX_LINE 1024
+
+typedef struct
+{
+    double sent;  /* time the outstanding `go` was sent */
+    bool waiting; /* a `go` is outstanding; false once the server rejected the session */
+    unsigned seed;
+} LoadSession;
+
+Board start = {
+    BOARD_BIT(4, 5) | BOARD_BIT(5, 4) /* X_BLACK */,
+    BOARD_BIT(4, 4) | BOARD_BIT(5, 5) /* O_WHITE */
+};
+
+int server;
+string output; /* commands not sent yet */
+
+void send_line(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void send_line(const char *format, ...)
+{
+    char line[LOAD_MAX_LINE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    output += line;
+    output += '\n';
+}
+
+// Send the commands gathered by send_line; false if the server went away
+bool flush_output()
+{
+    for (size_t written = 0; written < output.size();)
+    {
+        ssize_t n = write(server, output.data() + written, output.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        written += n;
+    }
+    output.clear();
+    return true;
+}
+
+// Start a game in session `id` from `plies` random moves, and ask for its first move
+void start_game(LoadSession *session, int id, int plies, int depth, int milliseconds)
+{
+    Board b = start;
+    int color = X_BLACK;
+    for (int i = 0; i < plies; i++)
+    {
+        ull moves = bb_kernel.legal_moves(b.disks[color], b.disks[OTHERCOLOR(color)]);
+        if (moves)
+        {
+            for (int skip = rand_r(&session->seed) % bb_popcount(moves); skip > 0; skip--)
+                moves &= moves - 1;
+            play_square(&b, bb_first_square(moves), color);
+        }
+        color = OTHERCOLOR(color);
+    }
+    char squares[65];
+    for (int sq = 63; sq >= 0; sq--)
+        squares[63 - sq] = (b.disks[X_BLACK] & BB_SQUARE_BIT(sq)) ? 'X' : (b.disks[O_WHITE] & BB_SQUARE_BIT(sq)) ? 'O' : '-';
+    squares[64] = '\0';
+    send_line("new %d %d %d", id, depth, milliseconds);
+    send_line("position %d %s %c", id, squares, color == X_BLACK ? 'X' : 'O');
+    send_line("go %d", id);
+    session->sent = now_seconds();
+    session->waiting = true;
+}
+
+// Connect to the Unix domain socket `path`; -1 if there is no server
+int connect_socket(const char *path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Read the next line of the server into `line`; false if it went away
+bool read_line(string *input, string *line)
+{
+    size_t end;
+    while ((end = input->find('\n')) == string::npos)
+    {
+        char buffer[65536];
+        ssize_t n = read(server, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        input->append(buffer, n);
+    }
+    *line = input->substr(0, end);
+    input->erase(0, end + 1);
+    return true;
+}
+
+void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s -u socket_path [-d depth] [-m milliseconds] [-n moves] [-R plies] [-s sessions]\n", program);
+    fprintf(stderr, "  -d  maximum search depth of a move (default: the server's)\n");
+    fprintf(stderr, "  -m  time per move of the sessions (default: the server's)\n");
+    fprintf(stderr, "  -n  moves to play in all (default %d)\n", LOAD_DEFAULT_MOVES);
+    fprintf(stderr, "  -R  random moves of the opening of each game (default %d)\n", LOAD_DEFAULT_RANDOM_PLIES);
+    fprintf(stderr, "  -s  concurrent sessions (default %d)\n", LOAD_DEFAULT_SESSIONS);
+    fprintf(stderr, "  -u  the Unix domain socket of the server (othello-server -u)\n");
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *socket_path = NULL;
+    int nsessions = LOAD_DEFAULT_SESSIONS;
+    long target = LOAD_DEFAULT_MOVES;
+    int plies = LOAD_DEFAULT_RANDOM_PLIES;
+    int depth = 0, milliseconds = 0;
+    int opt;
+    while ((opt = getopt(argc, (char *const *)argv, "d:m:n:R:s:u:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            depth = atoi(optarg);
+            break;
+        case 'm':
+            milliseconds = atoi(optarg);
+            break;
+        case 'n':
+            target = atol(optarg);
+            break;
+        case 'R':
+            plies = atoi(optarg);
+            break;
+        case 's':
+            nsessions = atoi(optarg);
+            break;
+        case 'u':
+            socket_path = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (socket_path == NULL || nsessions <= 0 || target <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    engine_library_init();
+    if ((server = connect_socket(socket_path)) < 0)
+    {
+        perror(socket_path);
+        return 1;
+    }
+
+    vector<LoadSession> sessions(nsessions);
+    vector<double> latencies;
+    long games = 0, errors = 0, outstanding = nsessions;
+    double begin = now_seconds();
+    for (int id = 0; id < nsessions; id++)
+    {
+        sessions[id].seed = id + 1;
+        start_game(&sessions[id], id, plies, depth, milliseconds);
+    }
+
+    string input, line;
+    while (outstanding > 0 && flush_output() && read_line(&input, &line))
+    {
+        char answer[16];
+        int id;
+        if (sscanf(line.c_str(), "%15s %d", answer, &id) != 2 || id < 0 || id >= nsessions)
+            continue;
+        LoadSession *session = &sessions[id];
+        if (strcmp(answer, "error") == 0)
+        {
+            fprintf(stderr, "%s\n", line.c_str());
+            errors++;
+            // No move follows the rejected command: the session is done
+            if (session->waiting)
+            {
+                session->waiting = false;
+                outstanding--;
+            }
+            continue;
+        }
+        if (strcmp(answer, "move") != 0 && strcmp(answer, "over") != 0)
+            continue;
+        if (!session->waiting)
+            continue;
+
+        session->waiting = false;
+        outstanding--;
+        if (strcmp(answer, "move") == 0)
+            latencies.push_back(now_seconds() - session->sent);
+        if ((long)latencies.size() + outstanding >= target)
+            continue;
+        outstanding++;
+        session->waiting = true;
+        if (strcmp(answer, "over") == 0)
+        {
+            games++;
+            start_game(session, id, plies, depth, milliseconds);
+        }
+        else
+        {
+            send_line("go %d", id);
+            session->sent = now_seconds();
+        }
+    }
+    double seconds = now_seconds() - begin;
+    if (outstanding > 0)
+    {
+        fprintf(stderr, "the server went away\n");
+        return 1;
+    }
+    if (latencies.empty())
+    {
+        fprintf(stderr, "the server rejected every session\n");
+        return 1;
+    }
+
+    sort(latencies.begin(), latencies.end());
+    long moves = latencies.size();
+    printf("%d sessions, %ld moves, %ld games in %.3f seconds: %.1f moves/sec, latency p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+           nsessions, moves, games, seconds, seconds > 0 ? moves / seconds : 0.0,
+           latencies[(size_t)(0.50 * (moves - 1) + 0.5)] * 1000, latencies[(size_t)(0.99 * (moves - 1) + 0.5)] * 1000,
+           latencies[moves - 1] * 1000);
+
+    send_line("stats");
+    while (flush_output() && read_line(&input, &line))
+    {
+        if (strncmp(line.c_str(), "stats ", 6) == 0)
+        {
+            printf("server: %s\n", line.c_str());
+            break;
+        }
+    }
+    send_line("quit");
+    flush_output();
+    close(server);
+    return errors > 0 ? 1 : 0;
+}
@@ -2,6 +2,16 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <vector>
+#include <unistd.h>
+#include <time.h>
+#include "bitboard_simd.h"
+#include "transposition.h"
+#include "ordering.h"
+#include "position.h"
+#include "search_stack.h"
+#include "book.h"
+#include "cache.h"
+#include "symmetry.h"
 using namespace std;
 
 #define BIT 0x1
@@ -16,21 +26,21 @@ these macros index from a row,column position on the board
 to a position and bit in a game board bitvector
 */
 #define BOARD_BIT_INDEX(row, col) ((8 - (row)) * 8 + (8 - (col)))
-#define BOARD_BIT(row, col) (0x1LL << BOARD_BIT_INDEX(row, col))
+#define BOARD_BIT(row, col) (0x1ULL << BOARD_BIT_INDEX(row, col))
 #define MOVE_TO_BOARD_BIT(m) BOARD_BIT(m.row, m.col)
 
-/* all of the bits in the row 8 */
-#define ROW8                                                                 \
-    (BOARD_BIT(8, 1) | BOARD_BIT(8, 2) | BOARD_BIT(8, 3) | BOARD_BIT(8, 4) | \
-     BOARD_BIT(8, 5) | BOARD_BIT(8, 6) | BOARD_BIT(8, 7) | BOARD_BIT(8, 8))
+/* all of the bits in the row 8, folded at compile time */
+constexpr ull ROW8 =
+    BOARD_BIT(8, 1) | BOARD_BIT(8, 2) | BOARD_BIT(8, 3) | BOARD_BIT(8, 4) |
+    BOARD_BIT(8, 5) | BOARD_BIT(8, 6) | BOARD_BIT(8, 7) | BOARD_BIT(8, 8);
 
 /* all of the bits in column 8 */
-#define COL8                                                                 \
-    (BOARD_BIT(1, 8) | BOARD_BIT(2, 8) | BOARD_BIT(3, 8) | BOARD_BIT(4, 8) | \
-     BOARD_BIT(5, 8) | BOARD_BIT(6, 8) | BOARD_BIT(7, 8) | BOARD_BIT(8, 8))
+constexpr ull COL8 =
+    BOARD_BIT(1, 8) | BOARD_BIT(2, 8) | BOARD_BIT(3, 8) | BOARD_BIT(4, 8) |
+    BOARD_BIT(5, 8) | BOARD_BIT(6, 8) | BOARD_BIT(7, 8) | BOARD_BIT(8, 8);
 
 /* all of the bits in column 1 */
-#define COL1 (COL8 << 7)
+constexpr ull COL1 = COL8 << 7;
 
 // Check if this move is out of board boundaries
 #define IS_MOVE_OFF_BOARD(m) (m.row < 1 || m.row > 8 || m.col < 1 || m.col > 8)
@@ -71,11 +81,11 @@ Board start = {
     BOARD_BIT(4, 4) | BOARD_BIT(5, 5) /* O_WHITE */
 };
 
-Move offsets[] = {
+constexpr Move offsets[] = {
     {0, 1} /* right */, {0, -1} /* left */, {-1, 0} /* up */, {1, 0} /* down */, {-1, -1} /* up-left */, {-1, 1} /* up-right */, {1, 1} /* down-right */, {1, -1} /* down-left */
 };
 
-int noffsets = sizeof(offsets) / sizeof(Move);
+constexpr int noffsets = sizeof(offsets) / sizeof(Move);
 char diskcolor[] = {'.', 'X', 'O', 'I'};
 
 void PrintDisk(int x_black, int o_white)
@@ -212,74 +222,19 @@ void ReadMove(int color, Board *b)
     }
 }
 
-/*
-Return all possible and valid locations of placing disk for each color (Board):
-    return the set of board positions adjacent to an opponent's
-    disk that are empty. these represent a candidate set of
-    positions for a move by color.
-*/
-Board NeighborMoves(Board b, int color)
-{
-    int i;
-    Board neighbors = {0, 0};
-    for (i = 0; i < noffsets; i++)
-    {
-        ull colmask = (offsets[i].col != 0) ? ((offsets[i].col > 0) ? COL1 : COL8) : 0;
-        int offset = MOVE_OFFSET_TO_BIT_OFFSET(offsets[i]);
-
-        if (offset > 0)
-        {
-            neighbors.disks[color] |=
-                (b.disks[OTHERCOLOR(color)] >> offset) & ~colmask;
-        }
-        else
-        {
-            neighbors.disks[color] |=
-                (b.disks[OTHERCOLOR(color)] << -offset) & ~colmask;
-        }
-    }
-    neighbors.disks[color] &= ~(b.disks[X_BLACK] | b.disks[O_WHITE]);
-    return neighbors;
-}
-
 /*
 Return the number of valid number (int):
     return the set of board positions that represent legal
     moves for color. this is the set of empty board positions
-    that are adjacent to an opponent's disk where placing a
-    disk of color will cause one or more of the opponent's
-    disks to be flipped.
+    where placing a disk of color will cause one or more of the
+    opponent's disks to be flipped. all candidate squares are
+    computed at once with bitboard shifts (see bitboard.h).
 */
 int EnumerateLegalMoves(Board b, int color, Board *legal_moves)
 {
-    static Board no_legal_moves = {0, 0};
-    Board neighbors = NeighborMoves(b, color);
-    ull my_neighbor_moves = neighbors.disks[color];
-    int row;
-    int col;
-
-    int num_moves = 0;
-    *legal_moves = no_legal_moves;
-
-    for (row = 8; row >= 1; row--)
-    {
-        ull thisrow = my_neighbor_moves & ROW8;
-        for (col = 8; thisrow && (col >= 1); col--)
-        {
-            if (thisrow & COL8)
-            {
-                Move m = {row, col};
-                if (FlipDisks(m, &b, color, 0, 0) > 0)
-                {
-                    legal_moves->disks[color] |= BOARD_BIT(row, col);
-                    num_moves++;
-                }
-            }
-            thisrow >>= 1;
-        }
-        my_neighbor_moves >>= 8;
-    }
-    return num_moves;
+    legal_moves->disks[OTHERCOLOR(color)] = 0;
+    legal_moves->disks[color] = bb_kernel.legal_moves(b.disks[color], b.disks[OTHERCOLOR(color)]);
+    return bb_popcount(legal_moves->disks[color]);
 }
 
 bool HumanTurn(Board *b, int color)
@@ -330,23 +285,15 @@ int utility(Board *b, int color)
     return CountBitsOnBoard(b, color) - CountBitsOnBoard(b, OTHERCOLOR(color));
 }
 
-vector<Move> get_valid_positions(Board *b, ull move, int color)
+vector<Move> get_valid_positions(ull move)
 {
     vector<Move> valid_positions = {};
-    for (auto row = 8; row >= 1; row--)
+    // lowest bit first keeps the original row 8..1, column 8..1 scan order
+    for (; move; move &= move - 1)
     {
-        ull thisrow = move & ROW8;
-        for (auto col = 8; thisrow && (col >= 1); col--)
-        {
-            if (thisrow & COL8)
-            {
-                Move m = {row, col};
-                if (FlipDisks(m, b, color, 0, 0) > 0)
-                    valid_positions.push_back(m);
-            }
-            thisrow >>= 1;
-        }
-        move >>= 8;
+        int sq = bb_first_square(move);
+        Move m = {BB_SQUARE_ROW(sq), BB_SQUARE_COL(sq)};
+        valid_positions.push_back(m);
     }
     return valid_positions;
 }
@@ -364,54 +311,136 @@ void print_move(Move move, int color)
 
 void place_disk(Board *b, Move move, int color)
 {
-    FlipDisks(move, b, color, 0, 1);
-    PlaceOrFlip(move, b, color);
+    ull flips = bb_kernel.flip_mask(BOARD_BIT_INDEX(move.row, move.col), b->disks[color], b->disks[OTHERCOLOR(color)]);
+    b->disks[color] |= flips | MOVE_TO_BOARD_BIT(move);
+    b->disks[OTHERCOLOR(color)] &= ~flips;
 }
 
-Action alphabeta_negamax(Board b, int color, int depth, int alpha, int beta)
+// Transposition table, sized with -t
+TranspositionTable tt = {NULL, 0, 0};
+
+// Move ordering, chosen with -o
+MoveOrdering move_ordering;
+
+// Print search statistics after every computer move, set with -s
+bool print_stats = false;
+
+// Start every computer move from an empty transposition table (-f) instead of the one kept from earlier moves
+bool fresh_search = false;
+
+// Opening book mapped with -L, empty without one
+OpeningBook opening_book;
+
+// Persistent position cache of -C, shared across runs
+PositionCache position_cache;
+
+// Merge what this run added to the position cache into its file, at exit
+void merge_position_cache()
 {
-    Action best_action;
+    if (!cache_merge(&position_cache))
+        perror(position_cache.path);
+}
+
+// Positions searched by alphabeta_negamax
+ull nodes_searched = 0;
+
+// Ply frames of alphabeta_negamax (see search_stack.h)
+SearchStack search_stack;
+
+// alphabeta_negamax of `pos`, made and unmade in place, on the ply frames from `frame` on; `frame` receives the score and the best move
+int alphabeta_frame(Position *pos, SearchFrame *frame, int depth, int ply, int alpha, int beta)
+{
+    nodes_searched++;
+    frame->best = STACK_NO_SQUARE;
     if (depth == 0)
+        return frame->score = position_score(pos);
+
+    // A stored bound may already decide this node, or at least narrow the window and give a first move to try
+    int alpha_orig = alpha;
+    TTResult hit;
+    BookEntry cached;
+    int hash_square = ORDER_NO_SQUARE;
+    if (depth >= TT_MIN_DEPTH && tt_probe(&tt, pos->key, &hit))
     {
-        best_action.utility = utility(&b, color);
-        return best_action;
-    }
-    else
-    {
-        Board legal_moves;
-        best_action.utility = INT_MIN;
-        EnumerateLegalMoves(b, color, &legal_moves);
-        vector<Move> valid_positions = get_valid_positions(&b, legal_moves.disks[color], color);
-        int num_of_legal_moves = valid_positions.size();
-        best_action.has_move = (num_of_legal_moves > 0) ? true : false;
-        for (auto i = 0; i < num_of_legal_moves; i++)
+        hash_square = hit.move;
+        if (hit.depth >= depth)
         {
-            Board new_board = b;
-            place_disk(&new_board, valid_positions[i], color);
-            Action current_action = alphabeta_negamax(new_board, OTHERCOLOR(color), depth - 1, -beta, -alpha);
-            int current_move_utility = -current_action.utility;
-            if (current_move_utility > best_action.utility)
+            if (hit.bound == TT_LOWER)
+                alpha = (hit.score > alpha) ? hit.score : alpha;
+            else if (hit.bound == TT_UPPER)
+                beta = (hit.score < beta) ? hit.score : beta;
+            if (hit.bound == TT_EXACT || alpha >= beta)
             {
-                best_action.move = valid_positions[i];
-                best_action.utility = current_move_utility;
+                if (hit.move != TT_NO_MOVE)
+                    frame->best = hit.move;
+                return frame->score = hit.score;
             }
-            alpha = (best_action.utility > alpha) ? best_action.utility : alpha;
-            if (alpha >= beta)
-                break;
         }
-        if (num_of_legal_moves == 0)
+    }
+    // Only a node the table does not decide pays for the canonical key and the binary search of the cache
+    if (cache_probe(&position_cache, pos->own, pos->opp, pos->color, depth, &cached))
+    {
+        frame->best = (cached.square < 64) ? cached.square : STACK_NO_SQUARE;
+        return frame->score = cached.score;
+    }
+
+    // Of moves that are images under a symmetry of the position, only one is searched (see symmetry.h)
+    ull moves = position_legal_moves(pos);
+    if (depth >= SYMMETRY_MIN_DEPTH)
+        moves = symmetry_unique_moves(pos->own, pos->opp, moves);
+    frame->nmoves = order_moves(&move_ordering, 0, pos->color, ply, pos->own, pos->opp, moves, hash_square, frame->moves);
+    frame->score = INT_MIN;
+    for (int i = 0; i < frame->nmoves; i++)
+    {
+        int sq = frame->moves[i];
+        position_make(pos, sq, &frame->undo);
+        int current_move_utility = -alphabeta_frame(pos, frame + 1, depth - 1, ply + 1, -beta, -alpha);
+        position_unmake(pos, &frame->undo);
+        if (current_move_utility > frame->score)
+        {
+            frame->best = sq;
+            frame->score = current_move_utility;
+        }
+        alpha = (frame->score > alpha) ? frame->score : alpha;
+        if (alpha >= beta)
         {
-            Board new_board = b;
-            if (EnumerateLegalMoves(new_board, OTHERCOLOR(color), &legal_moves) > 0)
-            {
-                Action current_action = alphabeta_negamax(new_board, OTHERCOLOR(color), depth, -beta, -alpha);
-                best_action.move = current_action.move;
-                best_action.utility = -current_action.utility;
-            }
-            else
-                best_action.utility = utility(&new_board, color);
+            ordering_cutoff(&move_ordering, 0, pos->color, ply, sq, depth, i);
+            break;
         }
     }
+    if (frame->nmoves == 0)
+    {
+        if (position_can_pass(pos))
+        {
+            position_pass(pos);
+            frame->score = -alphabeta_frame(pos, frame + 1, depth, ply + 1, -beta, -alpha);
+            position_pass(pos);
+        }
+        else
+            frame->score = position_score(pos);
+    }
+
+    if (depth >= TT_MIN_DEPTH)
+    {
+        int bound = (frame->score <= alpha_orig) ? TT_UPPER : (frame->score >= beta) ? TT_LOWER
+                                                                                      : TT_EXACT;
+        tt_store(&tt, pos->key, depth, bound, frame->score, (frame->best != STACK_NO_SQUARE) ? frame->best : TT_NO_MOVE);
+        if (bound == TT_EXACT)
+            cache_add(&position_cache, pos->own, pos->opp, pos->color, depth, frame->score, frame->best);
+    }
+    return frame->score;
+}
+
+Action alphabeta_negamax(Board b, int color, int depth, int ply, int alpha, int beta)
+{
+    Position pos;
+    position_set(&pos, b.disks, color);
+    SearchFrame *frame = search_stack.frames;
+    Action best_action;
+    best_action.utility = alphabeta_frame(&pos, frame, depth, ply, alpha, beta);
+    best_action.has_move = (frame->best != STACK_NO_SQUARE);
+    best_action.move.row = best_action.has_move ? BB_SQUARE_ROW(frame->best) : 0;
+    best_action.move.col = best_action.has_move ? BB_SQUARE_COL(frame->best) : 0;
     return best_action;
 };
 
@@ -419,12 +448,42 @@ Action alphabeta_negamax(Board b, int color, int depth, int alpha, int beta)
 bool ComputerTurn(Board *b, int color, int depth)
 {
     int alpha = -100, beta = 100;
-    Action computer_action = alphabeta_negamax(*b, color, depth, alpha, beta);
+    Action computer_action;
+    BookEntry entry;
+    // Play the book move without searching; a key collision could name any square, so it must be legal
+    if (book_probe_position(&opening_book, b->disks[color], b->disks[OTHERCOLOR(color)], color, &entry) && entry.square < 64 &&
+        (bb_kernel.legal_moves(b->disks[color], b->disks[OTHERCOLOR(color)]) & BB_SQUARE_BIT(entry.square)))
+    {
+        computer_action.move.row = BB_SQUARE_ROW(entry.square);
+        computer_action.move.col = BB_SQUARE_COL(entry.square);
+        computer_action.utility = entry.score;
+        computer_action.has_move = true;
+        printf("Computer found the move in the opening book: searched %d moves ahead, %+d for %c\n", entry.depth,
+               entry.score, diskcolor[color + 1]);
+    }
+    else
+    {
+        // Reuse what the table kept from earlier moves
+        if (fresh_search)
+            tt_clear(&tt);
+        else
+            tt_new_search(&tt);
+        ordering_new_search(&move_ordering);
+        computer_action = alphabeta_negamax(*b, color, depth, 0, alpha, beta);
+        if (!cache_checkpoint(&position_cache))
+            perror(position_cache.path);
+    }
     Move best_move = computer_action.move;
     int row = best_move.row, column = best_move.col;
     if (computer_action.has_move)
     {
         printf("Computer have placed %c in [row %d, column %d]\n", diskcolor[color + 1], row, column);
+        if (print_stats)
+        {
+            OrderingStats stats = ordering_stats(&move_ordering);
+            printf("Ordered %llu nodes, %llu cutoffs, %.1f%% of them on the first move\n", stats.nodes, stats.cutoffs,
+                   stats.cutoffs ? 100.0 * stats.first_move_cutoffs / stats.cutoffs : 0.0);
+        }
         int nflips = FlipDisks(best_move, b, color, 0, 0);
         place_disk(b, best_move, color);
         printf("Computer flipped %d disks\n", nflips);
@@ -450,8 +509,207 @@ void handle_input(int id, char &player, int &depth)
     }
 }
 
+/*
+Benchmark of alphabeta_negamax on the positions of bench_positions.txt, in the same
+CSV or JSON rows as `othello -k` (see othello.cpp for the file format). Every position
+is searched to its alpha-beta depth from an empty table and fresh move ordering,
+and the node counts are checked against the alphabeta_negamax references.
+*/
+#define BENCH_ENGINE "alphabeta_negamax"
+
+double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Parse 64 squares (row 1 first, 'X', 'O', '-') and the side to move; return a pointer past them or NULL
+const char *parse_position(const char *text, Board *b, int *color)
+{
+    b->disks[X_BLACK] = b->disks[O_WHITE] = 0;
+    int squares = 0;
+    const char *p = text;
+    for (; *p && squares < 64; p++)
+    {
+        if (*p == ' ' || *p == '\t')
+            continue;
+        if (*p == 'X' || *p == 'x' || *p == '*')
+            b->disks[X_BLACK] |= BB_SQUARE_BIT(63 - squares);
+        else if (*p == 'O' || *p == 'o')
+            b->disks[O_WHITE] |= BB_SQUARE_BIT(63 - squares);
+        else if (*p != '-' && *p != '.')
+            return NULL;
+        squares++;
+    }
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (squares < 64 || !(*p == 'X' || *p == 'x' || *p == '*' || *p == 'O' || *p == 'o'))
+        return NULL;
+    *color = (*p == 'O' || *p == 'o') ? O_WHITE : X_BLACK;
+    return p + 1;
+}
+
+void print_bench_row(bool json, bool *first_row, const char *position, int depth, ull nodes, double seconds)
+{
+    double nps = seconds > 0 ? nodes / seconds : 0;
+    if (json)
+        printf("%s\n  {\"engine\": \"%s\", \"workers\": 1, \"position\": \"%s\", \"depth\": %d, \"nodes\": %llu, "
+               "\"seconds\": %.6f, \"nps\": %.0f, \"speedup\": 1.000, \"overhead\": 1.000}",
+               *first_row ? "" : ",", BENCH_ENGINE, position, depth, nodes, seconds, nps);
+    else
+        printf("%s,1,%s,%d,%llu,%.6f,%.0f,1.000,1.000\n", BENCH_ENGINE, position, depth, nodes, seconds, nps);
+    *first_row = false;
+}
+
+// Run the benchmark; return the number of node counts that differ from the reference, or 1 if `file` cannot be read
+int run_bench(const char *file, bool json, unsigned ordering_policy)
+{
+    FILE *in = fopen(file, "r");
+    if (in == NULL)
+    {
+        fprintf(stderr, "cannot read the benchmark positions in %s\n", file);
+        return 1;
+    }
+    char line[512];
+    int line_number = 0, mismatches = 0;
+    ull total_nodes = 0;
+    double total_seconds = 0;
+    bool first_row = true;
+    printf(json ? "[" : "engine,workers,position,depth,nodes,seconds,nps,speedup,overhead\n");
+    while (fgets(line, sizeof(line), in))
+    {
+        line_number++;
+        char name[32];
+        int negamax_depth, depth, color, length;
+        Board b;
+        const char *rest = NULL;
+        if (line[strspn(line, " \t\r\n")] == '\0' || line[strspn(line, " \t")] == '#')
+            continue;
+        if (sscanf(line, "%31s %d %d %n", name, &negamax_depth, &depth, &length) == 3)
+            rest = parse_position(line + length, &b, &color);
+        if (rest == NULL)
+        {
+            fprintf(stderr, "%s:%d: not a benchmark position\n", file, line_number);
+            fclose(in);
+            return 1;
+        }
+
+        tt_clear(&tt);
+        ordering_init(&move_ordering, ordering_policy);
+        nodes_searched = 0;
+        double begin = now_seconds();
+        alphabeta_negamax(b, color, depth, 0, -100, 100);
+        double seconds = now_seconds() - begin;
+        total_nodes += nodes_searched;
+        total_seconds += seconds;
+        print_bench_row(json, &first_row, name, depth, nodes_searched, seconds);
+
+        const char *expected = strstr(rest, " " BENCH_ENGINE "=");
+        ull expected_nodes;
+        if (expected && sscanf(expected + strlen(" " BENCH_ENGINE "="), "%llu", &expected_nodes) == 1 &&
+            expected_nodes != nodes_searched)
+        {
+            fprintf(stderr, "%s %s: searched %llu nodes, the reference is %llu\n", BENCH_ENGINE, name, nodes_searched, expected_nodes);
+            mismatches++;
+        }
+    }
+    fclose(in);
+    print_bench_row(json, &first_row, "total", 0, total_nodes, total_seconds);
+    printf(json ? "\n]\n" : "");
+    if (mismatches)
+        fprintf(stderr, "%d node counts differ from %s\n", mismatches, file);
+    return mismatches;
+}
+
+void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-C cache_file] [-c cache_megabytes] [-f] [-L book_file] [-o ordering] [-s] [-t table_megabytes]\n", program);
+    fprintf(stderr, "       %s -k bench_positions_file [-j]\n", program);
+    fprintf(stderr, "  -C  keep exact results of deep searches in this file across runs, shared with othello -C\n");
+    fprintf(stderr, "  -c  size cap of the -C file in MB (default %d)\n", CACHE_DEFAULT_MEGABYTES);
+    fprintf(stderr, "  -f  start every computer move from an empty transposition table\n");
+    fprintf(stderr, "  -j  print the benchmark as JSON instead of CSV\n");
+    fprintf(stderr, "  -k  benchmark alphabeta_negamax on the positions of the file, exit 1 if a node count changed\n");
+    fprintf(stderr, "  -L  play the moves of this opening book (built with othello -M) instead of searching them\n");
+    fprintf(stderr, "  -o  move ordering: none, default or a list of hash,killers,history,static,mobility\n");
+    fprintf(stderr, "  -s  print search statistics after every computer move\n");
+    fprintf(stderr, "  -t  transposition table size in MB, 0 disables it (default %d)\n", TT_DEFAULT_MEGABYTES);
+}
+
 int main(int argc, const char *argv[])
 {
+    // Handle command line options
+    size_t tt_megabytes = TT_DEFAULT_MEGABYTES;
+    unsigned ordering_policy = ORDER_DEFAULT;
+    const char *bench_file = NULL;
+    const char *book_file = NULL;
+    const char *cache_file = NULL;
+    size_t cache_megabytes = CACHE_DEFAULT_MEGABYTES;
+    bool bench_json = false;
+    int opt;
+    while ((opt = getopt(argc, (char *const *)argv, "C:c:fjk:L:o:st:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'C':
+            cache_file = optarg;
+            break;
+        case 'c':
+            cache_megabytes = atoi(optarg);
+            break;
+        case 'f':
+            fresh_search = true;
+            break;
+        case 'j':
+            bench_json = true;
+            break;
+        case 'k':
+            bench_file = optarg;
+            break;
+        case 'L':
+            book_file = optarg;
+            break;
+        case 'o':
+            if (!ordering_parse_policy(optarg, &ordering_policy))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 's':
+            print_stats = true;
+            break;
+        case 't':
+            tt_megabytes = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Pick the move generation kernel: OTHELLO_SIMD=scalar|lines|avx2|avx512, default is the fastest supported
+    bb_select_kernel(getenv("OTHELLO_SIMD"));
+    zobrist_init();
+    tt_init(&tt, tt_megabytes);
+    ordering_init(&move_ordering, ordering_policy);
+
+    if (bench_file)
+        return run_bench(bench_file, bench_json, ordering_policy) ? 1 : 0;
+
+    if (cache_file)
+    {
+        cache_open(&position_cache, cache_file, cache_megabytes);
+        atexit(merge_position_cache);
+    }
+
+    if (book_file && !book_open(&opening_book, book_file))
+    {
+        fprintf(stderr, "%s is not an opening book\n", book_file);
+        return 1;
+    }
+
     char player1, player2;
     int search_depth1, search_depth2;
     handle_input(1, player1, search_depth1);
@@ -467,6 +725,8 @@ int main(int argc, const char *argv[])
     } while (is_player1_movable || is_player2_movable);
 
     EndGame(gameboard);
+    if (print_stats)
+        printf("Computer players searched %llu nodes\n", nodes_searched);
 
     return 0;
 }
@@ -0,0 +1,686 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <algorithm>
+#include "engine.h"
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+using namespace std;
+
+/*
+the game server: many game sessions in one process, all searching on its one Cilk
+worker pool, instead of one process (and one Cilk runtime competing for the cores)
+per game.
+
+clients speak a line protocol over stdin/stdout or over a Unix domain socket (-u),
+one command per line. a session is named by a number chosen by the client and
+belongs to the connection that created it:
+    new <id> [<depth> [<milliseconds>]]   start a game from the start position, X to move;
+                                          the maximum depth and the time per move of the session
+    position <id> <64 squares> <X|O>      set the position, as in the -b text format of othello
+    play <id> <row>,<col>|pass            play the move of the side to move (a human move)
+    go <id>                               search and play the move of the side to move
+    close <id>                            end the session
+    stats                                 the throughput and latency of the server
+    quit                                  close the connection (on stdin: finish and exit)
+    shutdown                              stop the server
+the answers are
+    ok <id>
+    error <id> <message>
+    move <id> <row>,<col>|pass <score> <depth> exact|search <milliseconds>
+    over <id> <final disk differential of X>
+    stats <sessions> <moves> <moves/sec> <p50 ms> <p99 ms>
+moves/sec counts from the first `go` the server received; the percentiles are those of
+the last SERVER_LATENCY_WINDOW moves. a session runs its commands in order, so everything sent after a `go` waits for
+its move; the answers of different sessions may come in any order.
+
+scheduling: the server reads commands while no search runs, then runs a round of
+`go` searches concurrently, each with its own engine (engine.h) and its own time
+limit, one strand each on the shared worker pool. a round takes at most one move
+of a session and at most SERVER_SEARCHES_PER_WORKER searches per worker; it starts
+with the session after the last one served by the round before, so with more
+waiting sessions than a round holds every session still moves in turn. a search
+is timed by the time per move of its session, capped by the time limit of the
+server (-m), which so bounds the length of a round (an endgame solved exactly, -x,
+is not timed). the latency of a move runs from the arrival of its `go` to its
+answer, so it includes the wait for a round.
+
+the sockets of the clients are non-blocking: the answers of a connection are kept
+in its output buffer and written whenever the socket takes them, so a client that
+stops reading holds up nobody but itself, and it is dropped once SERVER_MAX_OUTPUT
+bytes of answers pile up. stdin and stdout are left blocking: they serve a single
+client, which may be a terminal.
+*/
+
+#define SERVER_DEFAULT_TABLE_MEGABYTES 1
+#define SERVER_DEFAULT_MILLISECONDS 100
+#define SERVER_DEFAULT_DEPTH 60
+
+/* concurrent searches of a round per worker; more than one keeps the workers busy while searches finish unevenly */
+#define SERVER_SEARCHES_PER_WORKER 2
+
+/* the latencies of this many recent moves make the percentiles */
+#define SERVER_LATENCY_WINDOW 65536
+
+#define SERVER_MAX_LINE 1024
+
+/* a client that leaves this many bytes of answers unread is dropped */
+#define SERVER_MAX_OUTPUT (1 << 20)
+
+typedef struct
+{
+    int in;  /* the socket, or stdin */
+    int out; /* the socket, or stdout */
+    string input;  /* read, not yet a whole line */
+    string output; /* answers not written yet */
+    bool closed;
+} Connection;
+
+typedef struct
+{
+    string line;
+    double arrival;
+} Request;
+
+typedef struct
+{
+    int connection;
+    int id;
+    Engine *engine;
+    Board board;
+    int color;
+    int depth;
+    double move_time;
+    deque<Request> requests; /* the commands not run yet, in order */
+} Session;
+
+Board start = {
+    BOARD_BIT(4, 5) | BOARD_BIT(5, 4) /* X_BLACK */,
+    BOARD_BIT(4, 4) | BOARD_BIT(5, 5) /* O_WHITE */
+};
+
+EngineConfig session_config;
+int max_depth = SERVER_DEFAULT_DEPTH;
+double max_move_time = SERVER_DEFAULT_MILLISECONDS / 1000.0;
+
+vector<Connection> connections;
+map<ull, Session *> sessions; /* by connection and id, see session_key */
+ull last_served;              /* key of the last session of the last round */
+bool input_done;              /* stdin ended or quit */
+bool shutting_down;
+
+// Served moves: count, first arrival and latencies in seconds (a ring of the last SERVER_LATENCY_WINDOW)
+ull moves_served;
+double first_arrival;
+vector<double> latencies;
+
+static inline ull session_key(int connection, int id)
+{
+    return ((ull)connection << 32) | (unsigned)id;
+}
+
+// Write what the client of `c` takes of its answers without blocking; a client that went away is closed
+void flush_output(Connection *c)
+{
+    size_t written = 0;
+    while (written < c->output.size())
+    {
+        ssize_t n = write(c->out, c->output.data() + written, c->output.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+        {
+            c->closed = true;
+            c->output.clear();
+            return;
+        }
+        written += n;
+    }
+    c->output.erase(0, written);
+}
+
+// Queue a line for the client of `connection` (see flush_output); a client too far behind is dropped
+void reply(int connection, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void reply(int connection, const char *format, ...)
+{
+    Connection *c = &connections[connection];
+    if (c->closed)
+        return;
+    char line[SERVER_MAX_LINE];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (length > (int)sizeof(line) - 2)
+        length = sizeof(line) - 2;
+    line[length++] = '\n';
+    c->output.append(line, length);
+    if (c->output.size() > SERVER_MAX_OUTPUT)
+    {
+        c->closed = true;
+        c->output.clear();
+    }
+}
+
+// The p-th percentile of the recent move latencies, in milliseconds
+double latency_percentile(double p)
+{
+    if (latencies.empty())
+        return 0;
+    vector<double> sorted(latencies);
+    size_t rank = (size_t)(p / 100 * (sorted.size() - 1) + 0.5);
+    nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank] * 1000;
+}
+
+void record_latency(double seconds)
+{
+    if (latencies.size() < SERVER_LATENCY_WINDOW)
+        latencies.push_back(seconds);
+    else
+        latencies[moves_served % SERVER_LATENCY_WINDOW] = seconds;
+    moves_served++;
+}
+
+double moves_per_second()
+{
+    double seconds = now_seconds() - first_arrival;
+    return (moves_served > 0 && seconds > 0) ? moves_served / seconds : 0.0;
+}
+
+void reply_stats(int connection)
+{
+    reply(connection, "stats %zu %llu %.1f %.1f %.1f", sessions.size(), moves_served, moves_per_second(),
+          latency_percentile(50), latency_percentile(99));
+}
+
+void delete_session(map<ull, Session *>::iterator s)
+{
+    delete s->second->engine;
+    delete s->second;
+    sessions.erase(s);
+}
+
+// Take a command of a session: it is queued behind the commands of the session still waiting
+void dispatch(int connection, const char *line, double arrival)
+{
+    char command[16];
+    int id, length;
+    if (sscanf(line, "%15s%n", command, &length) != 1)
+        return;
+    if (strcmp(command, "stats") == 0)
+    {
+        reply_stats(connection);
+        return;
+    }
+    if (strcmp(command, "quit") == 0)
+    {
+        if (connections[connection].in == STDIN_FILENO)
+            input_done = true;
+        else
+            connections[connection].closed = true;
+        return;
+    }
+    if (strcmp(command, "shutdown") == 0)
+    {
+        shutting_down = true;
+        return;
+    }
+    if (sscanf(line + length, "%d", &id) != 1)
+    {
+        reply(connection, "error - bad command: %s", line);
+        return;
+    }
+
+    ull key = session_key(connection, id);
+    map<ull, Session *>::iterator s = sessions.find(key);
+    if (s == sessions.end())
+    {
+        if (strcmp(command, "new") != 0)
+        {
+            reply(connection, "error %d no such session", id);
+            return;
+        }
+        Session *session = new Session();
+        session->connection = connection;
+        session->id = id;
+        session->engine = new Engine(session_config);
+        s = sessions.insert(make_pair(key, session)).first;
+    }
+    Request request = {line, arrival};
+    s->second->requests.push_back(request);
+    if (strcmp(command, "go") == 0 && first_arrival == 0)
+        first_arrival = arrival;
+}
+
+static inline bool is_go(const Request &request)
+{
+    return strncmp(request.line.c_str(), "go", 2) == 0 && (request.line[2] == ' ' || request.line[2] == '\t');
+}
+
+// Run a command of `session` other than `go`; return false if it closed the session
+bool run_command(Session *session, const char *line)
+{
+    char command[16], text[SERVER_MAX_LINE];
+    int id, length;
+    sscanf(line, "%15s %d%n", command, &id, &length);
+    const char *rest = line + length;
+
+    if (strcmp(command, "new") == 0)
+    {
+        int depth = max_depth, milliseconds = 0;
+        sscanf(rest, "%d %d", &depth, &milliseconds);
+        double move_time = milliseconds / 1000.0;
+        session->depth = (depth > 0 && depth < max_depth) ? depth : max_depth;
+        session->move_time = (move_time > 0 && move_time < max_move_time) ? move_time : max_move_time;
+        session->board = start;
+        session->color = X_BLACK;
+        session->engine->new_game();
+    }
+    else if (strcmp(command, "position") == 0)
+    {
+        Board b;
+        int color;
+        if (!parse_position(rest, &b, &color))
+        {
+            reply(session->connection, "error %d not a position", id);
+            return true;
+        }
+        session->board = b;
+        session->color = color;
+    }
+    else if (strcmp(command, "play") == 0)
+    {
+        ull legal = bb_kernel.legal_moves(session->board.disks[session->color], session->board.disks[OTHERCOLOR(session->color)]);
+        Move m;
+        if (sscanf(rest, " %d,%d", &m.row, &m.col) == 2 && m.row >= 1 && m.row <= 8 && m.col >= 1 && m.col <= 8 &&
+            (legal & MOVE_TO_BOARD_BIT(m)))
+            play_square(&session->board, BOARD_BIT_INDEX(m.row, m.col), session->color);
+        else if (!(sscanf(rest, " %15s", text) == 1 && strcmp(text, "pass") == 0 && legal == 0))
+        {
+            reply(session->connection, "error %d illegal move", id);
+            return true;
+        }
+        session->color = OTHERCOLOR(session->color);
+    }
+    else if (strcmp(command, "close") == 0)
+    {
+        reply(session->connection, "ok %d", id);
+        return false;
+    }
+    else
+    {
+        reply(session->connection, "error %d bad command: %s", id, command);
+        return true;
+    }
+    reply(session->connection, "ok %d", id);
+    return true;
+}
+
+/*
+Run the queued commands of every session up to its first `go`. The commands a
+closed session still had are taken again, as if they just arrived. Return how many
+sessions wait on a search.
+*/
+int run_commands()
+{
+    int waiting;
+    bool taken_again;
+    do
+    {
+        waiting = 0;
+        taken_again = false;
+        for (map<ull, Session *>::iterator s = sessions.begin(); s != sessions.end();)
+        {
+            Session *session = s->second;
+            bool open = true;
+            while (open && !session->requests.empty() && !is_go(session->requests.front()))
+            {
+                Request request = session->requests.front();
+                session->requests.pop_front();
+                open = run_command(session, request.line.c_str());
+            }
+            if (!open)
+            {
+                deque<Request> rest;
+                rest.swap(session->requests);
+                int connection = session->connection;
+                delete_session(s++);
+                for (size_t i = 0; i < rest.size(); i++)
+                    dispatch(connection, rest[i].line.c_str(), rest[i].arrival);
+                taken_again |= !rest.empty();
+                continue;
+            }
+            waiting += !session->requests.empty();
+            ++s;
+        }
+    } while (taken_again);
+    return waiting;
+}
+
+/*
+Search the `go` of the waiting sessions, at most `limit` of them, concurrently; the
+round starts after the session served last (see the scheduling above).
+*/
+void run_round(int limit)
+{
+    vector<Session *> round;
+    map<ull, Session *>::iterator s = sessions.upper_bound(last_served);
+    for (size_t visited = 0; visited < sessions.size() && (int)round.size() < limit; visited++, ++s)
+    {
+        if (s == sessions.end())
+            s = sessions.begin();
+        if (!s->second->requests.empty())
+        {
+            round.push_back(s->second);
+            last_served = s->first;
+        }
+    }
+
+    int n = round.size();
+    vector<SearchResult> results(n);
+    cilk_for(int i = 0; i < n; i++)
+    {
+        Session *session = round[i];
+        SearchLimits limits = {session->depth, session->move_time, ENGINE_DEFAULT, 0};
+        session->engine->set_position(session->board, session->color);
+        results[i] = session->engine->search(limits);
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        Session *session = round[i];
+        const SearchResult *result = &results[i];
+        Request request = session->requests.front();
+        session->requests.pop_front();
+        if (result->source == SEARCH_OVER)
+        {
+            int differential = result->action.utility * (session->color == X_BLACK ? 1 : -1);
+            reply(session->connection, "over %d %+d", session->id, differential);
+            continue;
+        }
+        Move move = result->action.move;
+        if (move.row == 0)
+            reply(session->connection, "move %d pass %+d %d %s %.1f", session->id, result->action.utility,
+                  result->depth, result->exact ? "exact" : "search", result->seconds * 1000);
+        else
+        {
+            play_square(&session->board, BOARD_BIT_INDEX(move.row, move.col), session->color);
+            reply(session->connection, "move %d %d,%d %+d %d %s %.1f", session->id, move.row, move.col,
+                  result->action.utility, result->depth, result->exact ? "exact" : "search", result->seconds * 1000);
+        }
+        session->color = OTHERCOLOR(session->color);
+        record_latency(now_seconds() - request.arrival);
+    }
+}
+
+// Take the whole lines read from `connection`
+void take_lines(int connection, double arrival)
+{
+    string &input = connections[connection].input;
+    size_t begin = 0, end;
+    while ((end = input.find('\n', begin)) != string::npos)
+    {
+        string line = input.substr(begin, end - begin);
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        dispatch(connection, line.c_str(), arrival);
+        begin = end + 1;
+    }
+    input.erase(0, begin);
+    if (input.size() > SERVER_MAX_LINE)
+    {
+        reply(connection, "error - line too long");
+        input.clear();
+    }
+}
+
+// Drop the sessions of the connections that went away
+void drop_closed_connections()
+{
+    for (map<ull, Session *>::iterator s = sessions.begin(); s != sessions.end();)
+    {
+        if (connections[s->second->connection].closed)
+            delete_session(s++);
+        else
+            ++s;
+    }
+    for (size_t c = 0; c < connections.size(); c++)
+    {
+        if (connections[c].closed && connections[c].in >= 0)
+        {
+            // The answers a client still had before its quit, as far as they go out at once
+            flush_output(&connections[c]);
+            if (connections[c].in != STDIN_FILENO)
+                close(connections[c].in);
+            connections[c].in = -1;
+        }
+    }
+}
+
+/*
+Write the answers waiting for the clients, read what they sent, and accept new
+clients on `listener` (-1 without a socket); wait at most `timeout` milliseconds
+(-1 until a client sends something or takes more of its answers).
+*/
+void read_input(int listener, int timeout)
+{
+    vector<struct pollfd> fds;
+    vector<int> owners;
+    if (listener >= 0)
+    {
+        struct pollfd fd = {listener, POLLIN, 0};
+        fds.push_back(fd);
+        owners.push_back(-1);
+    }
+    for (size_t c = 0; c < connections.size(); c++)
+    {
+        Connection *connection = &connections[c];
+        if (connection->closed || connection->in < 0)
+            continue;
+        flush_output(connection);
+        short events = 0;
+        if (!(connection->in == STDIN_FILENO && input_done))
+            events |= POLLIN;
+        if (!connection->output.empty())
+            events |= POLLOUT;
+        if (events == 0)
+            continue;
+        // stdin and stdout are two descriptors; a socket is both
+        if ((events & POLLOUT) && connection->out != connection->in)
+        {
+            struct pollfd out = {connection->out, POLLOUT, 0};
+            fds.push_back(out);
+            owners.push_back(c);
+            events &= ~POLLOUT;
+            if (events == 0)
+                continue;
+        }
+        struct pollfd fd = {connection->in, events, 0};
+        fds.push_back(fd);
+        owners.push_back(c);
+    }
+    if (fds.empty() || poll(fds.data(), fds.size(), timeout) <= 0)
+        return;
+
+    double arrival = now_seconds();
+    for (size_t i = 0; i < fds.size(); i++)
+    {
+        if (owners[i] < 0)
+        {
+            int client = (fds[i].revents & POLLIN) ? accept(listener, NULL, NULL) : -1;
+            if (client >= 0)
+            {
+                fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+                Connection c = {client, client, string(), string(), false};
+                connections.push_back(c);
+            }
+            continue;
+        }
+        Connection *c = &connections[owners[i]];
+        if (fds[i].revents & POLLOUT)
+            flush_output(c);
+        if (fds[i].fd != c->in || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) || c->closed)
+            continue;
+        char buffer[65536];
+        ssize_t n = read(c->in, buffer, sizeof(buffer));
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+            continue;
+        if (n <= 0)
+        {
+            if (c->in == STDIN_FILENO)
+                input_done = true;
+            else
+                c->closed = true;
+            continue;
+        }
+        c->input.append(buffer, n);
+        take_lines(owners[i], arrival);
+    }
+}
+
+// Listen on the Unix domain socket `path`; -1 if it cannot be created
+int listen_socket(const char *path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, path);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+        return -1;
+    unlink(path);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0)
+    {
+        close(listener);
+        return -1;
+    }
+    return listener;
+}
+
+void stop_server(int)
+{
+    shutting_down = true;
+}
+
+void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-u socket_path] [-d depth] [-e alphabeta|negamax|lazysmp] [-m milliseconds] [-r searches] [-t table_megabytes] [-x empties]\n", program);
+    fprintf(stderr, "  -d  maximum search depth of a move (default %d)\n", SERVER_DEFAULT_DEPTH);
+    fprintf(stderr, "  -e  parallel search engine (default alphabeta)\n");
+    fprintf(stderr, "  -m  time limit of a move, and the time per move of a session that sets none (default %d)\n", SERVER_DEFAULT_MILLISECONDS);
+    fprintf(stderr, "  -r  concurrent searches of a round (default %d per worker)\n", SERVER_SEARCHES_PER_WORKER);
+    fprintf(stderr, "  -t  transposition table of each session in MB, 0 disables it (default %d)\n", SERVER_DEFAULT_TABLE_MEGABYTES);
+    fprintf(stderr, "  -u  serve the clients of this Unix domain socket instead of stdin and stdout\n");
+    fprintf(stderr, "  -x  solve the game exactly once this many squares are empty, 0 never (default %d)\n", ENDGAME_DEFAULT_EMPTIES);
+}
+
+int main(int argc, const char *argv[])
+{
+    session_config = engine_default_config();
+    session_config.table_megabytes = SERVER_DEFAULT_TABLE_MEGABYTES;
+    const char *socket_path = NULL;
+    int round_size = __cilkrts_get_nworkers() * SERVER_SEARCHES_PER_WORKER;
+    int opt;
+    while ((opt = getopt(argc, (char *const *)argv, "d:e:m:r:t:u:x:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            max_depth = atoi(optarg);
+            break;
+        case 'e':
+            if (!parse_engine(optarg, &session_config.engine))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'm':
+            max_move_time = atoi(optarg) / 1000.0;
+            break;
+        case 'r':
+            round_size = atoi(optarg);
+            break;
+        case 't':
+            session_config.table_megabytes = atoi(optarg);
+            break;
+        case 'u':
+            socket_path = optarg;
+            break;
+        case 'x':
+            session_config.endgame_empties = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (max_depth <= 0 || max_move_time <= 0 || round_size <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // The board code of the server plays moves with the kernel of the library
+    engine_library_init();
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = -1;
+    if (socket_path)
+    {
+        if ((listener = listen_socket(socket_path)) < 0)
+        {
+            perror(socket_path);
+            return 1;
+        }
+        signal(SIGINT, stop_server);
+        signal(SIGTERM, stop_server);
+    }
+    else
+    {
+        Connection console = {STDIN_FILENO, STDOUT_FILENO, string(), string(), false};
+        connections.push_back(console);
+    }
+
+    while (!shutting_down)
+    {
+        int waiting = run_commands();
+        if (waiting == 0 && input_done && listener < 0)
+            break;
+        read_input(listener, waiting > 0 ? 0 : -1);
+        drop_closed_connections();
+        if (run_commands() > 0)
+            run_round(round_size);
+    }
+
+    for (size_t c = 0; c < connections.size(); c++)
+        if (!connections[c].closed)
+            flush_output(&connections[c]);
+    fprintf(stderr, "served %llu moves, %.1f moves/sec, latency p50 %.1f ms, p99 %.1f ms\n", moves_served,
+            moves_per_second(), latency_percentile(50), latency_percentile(99));
+    while (!sessions.empty())
+        delete_session(sessions.begin());
+    if (listener >= 0)
+    {
+        close(listener);
+        unlink(socket_path);
+    }
+    return 0;
+}
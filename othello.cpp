@@ -1,37 +1,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include "engine.h"
 #include <cilk/cilk.h>
-#include <cilk/reducer_max.h>
+#include <cilk/cilk_api.h>
 using namespace std;
 
-#define BIT 0x1
-
-#define X_BLACK 0
-#define O_WHITE 1
-#define OTHERCOLOR(c) (1 - (c))
-
 /*
-represent game board squares as a 64-bit unsigned integer.
-these macros index from a row,column position on the board
-to a position and bit in a game board bitvector
+the console front-end of the engine (engine.h, engine.cpp): games against a human
+or between computer players, batch analysis, the opening book builder, tournaments
+and the benchmark. everything here reads and prints; every search goes through an
+Engine.
 */
-#define BOARD_BIT_INDEX(row, col) ((8 - (row)) * 8 + (8 - (col)))
-#define BOARD_BIT(row, col) (0x1LL << BOARD_BIT_INDEX(row, col))
-#define MOVE_TO_BOARD_BIT(m) BOARD_BIT(m.row, m.col)
 
-/* all of the bits in the row 8 */
-#define ROW8                                                                 \
-    (BOARD_BIT(8, 1) | BOARD_BIT(8, 2) | BOARD_BIT(8, 3) | BOARD_BIT(8, 4) | \
-     BOARD_BIT(8, 5) | BOARD_BIT(8, 6) | BOARD_BIT(8, 7) | BOARD_BIT(8, 8))
+#define BIT 0x1
+
+/* all of the bits in the row 8, folded at compile time */
+constexpr ull ROW8 =
+    BOARD_BIT(8, 1) | BOARD_BIT(8, 2) | BOARD_BIT(8, 3) | BOARD_BIT(8, 4) |
+    BOARD_BIT(8, 5) | BOARD_BIT(8, 6) | BOARD_BIT(8, 7) | BOARD_BIT(8, 8);
 
 /* all of the bits in column 8 */
-#define COL8                                                                 \
-    (BOARD_BIT(1, 8) | BOARD_BIT(2, 8) | BOARD_BIT(3, 8) | BOARD_BIT(4, 8) | \
-     BOARD_BIT(5, 8) | BOARD_BIT(6, 8) | BOARD_BIT(7, 8) | BOARD_BIT(8, 8))
+constexpr ull COL8 =
+    BOARD_BIT(1, 8) | BOARD_BIT(2, 8) | BOARD_BIT(3, 8) | BOARD_BIT(4, 8) |
+    BOARD_BIT(5, 8) | BOARD_BIT(6, 8) | BOARD_BIT(7, 8) | BOARD_BIT(8, 8);
 
 /* all of the bits in column 1 */
-#define COL1 (COL8 << 7)
+constexpr ull COL1 = COL8 << 7;
 
 // Check if this move is out of board boundaries
 #define IS_MOVE_OFF_BOARD(m) (m.row < 1 || m.row > 8 || m.col < 1 || m.col > 8)
@@ -42,40 +39,16 @@ to a position and bit in a game board bitvector
 // Map Move (row, column) to bit format
 #define MOVE_OFFSET_TO_BIT_OFFSET(m) (m.row * 8 + m.col)
 
-typedef unsigned long long ull;
-
-/*
-game board represented as a pair of bit vectors:
-    - one for x_black disks on the board
-    - one for o_white disks on the board
-*/
-typedef struct
-{
-    ull disks[2];
-} Board;
-
-typedef struct
-{
-    int row;
-    int col;
-} Move;
-
-typedef struct
-{
-    int utility;
-    Move move;
-} Action;
-
 Board start = {
     BOARD_BIT(4, 5) | BOARD_BIT(5, 4) /* X_BLACK */,
     BOARD_BIT(4, 4) | BOARD_BIT(5, 5) /* O_WHITE */
 };
 
-Move offsets[] = {
+constexpr Move offsets[] = {
     {0, 1} /* right */, {0, -1} /* left */, {-1, 0} /* up */, {1, 0} /* down */, {-1, -1} /* up-left */, {-1, 1} /* up-right */, {1, 1} /* down-right */, {1, -1} /* down-left */
 };
 
-int noffsets = sizeof(offsets) / sizeof(Move);
+constexpr int noffsets = sizeof(offsets) / sizeof(Move);
 char diskcolor[] = {'.', 'X', 'O', 'I'};
 
 void PrintDisk(int x_black, int o_white)
@@ -212,74 +185,19 @@ void ReadMove(int color, Board *b)
     }
 }
 
-/*
-Return all possible and valid locations of placing disk for each color (Board):
-    return the set of board positions adjacent to an opponent's
-    disk that are empty. these represent a candidate set of
-    positions for a move by color.
-*/
-Board NeighborMoves(Board b, int color)
-{
-    int i;
-    Board neighbors = {0, 0};
-    for (i = 0; i < noffsets; i++)
-    {
-        ull colmask = (offsets[i].col != 0) ? ((offsets[i].col > 0) ? COL1 : COL8) : 0;
-        int offset = MOVE_OFFSET_TO_BIT_OFFSET(offsets[i]);
-
-        if (offset > 0)
-        {
-            neighbors.disks[color] |=
-                (b.disks[OTHERCOLOR(color)] >> offset) & ~colmask;
-        }
-        else
-        {
-            neighbors.disks[color] |=
-                (b.disks[OTHERCOLOR(color)] << -offset) & ~colmask;
-        }
-    }
-    neighbors.disks[color] &= ~(b.disks[X_BLACK] | b.disks[O_WHITE]);
-    return neighbors;
-}
-
 /*
 Return the number of valid number (int):
     return the set of board positions that represent legal
     moves for color. this is the set of empty board positions
-    that are adjacent to an opponent's disk where placing a
-    disk of color will cause one or more of the opponent's
-    disks to be flipped.
+    where placing a disk of color will cause one or more of the
+    opponent's disks to be flipped. all candidate squares are
+    computed at once with bitboard shifts (see bitboard.h).
 */
 int EnumerateLegalMoves(Board b, int color, Board *legal_moves)
 {
-    static Board no_legal_moves = {0, 0};
-    Board neighbors = NeighborMoves(b, color);
-    ull my_neighbor_moves = neighbors.disks[color];
-    int row;
-    int col;
-
-    int num_moves = 0;
-    *legal_moves = no_legal_moves;
-
-    for (row = 8; row >= 1; row--)
-    {
-        ull thisrow = my_neighbor_moves & ROW8;
-        for (col = 8; thisrow && (col >= 1); col--)
-        {
-            if (thisrow & COL8)
-            {
-                Move m = {row, col};
-                if (FlipDisks(m, &b, color, 0, 0) > 0)
-                {
-                    legal_moves->disks[color] |= BOARD_BIT(row, col);
-                    num_moves++;
-                }
-            }
-            thisrow >>= 1;
-        }
-        my_neighbor_moves >>= 8;
-    }
-    return num_moves;
+    legal_moves->disks[OTHERCOLOR(color)] = 0;
+    legal_moves->disks[color] = bb_kernel.legal_moves(b.disks[color], b.disks[OTHERCOLOR(color)]);
+    return bb_popcount(legal_moves->disks[color]);
 }
 
 bool HumanTurn(Board *b, int color)
@@ -330,27 +248,6 @@ int utility(Board *b, int color)
     return CountBitsOnBoard(b, color) - CountBitsOnBoard(b, OTHERCOLOR(color));
 }
 
-// Compute all valid positions for placing the `color` disk
-void get_valid_positions(Board *b, ull move, int color, Move *valid_positions)
-{
-    int i = 0;
-    for (auto row = 8; row >= 1; row--)
-    {
-        ull thisrow = move & ROW8;
-        for (auto col = 8; thisrow && (col >= 1); col--)
-        {
-            if (thisrow & COL8)
-            {
-                Move m = {row, col};
-                if (FlipDisks(m, b, color, 0, 0) > 0)
-                    valid_positions[i++] = m;
-            }
-            thisrow >>= 1;
-        }
-        move >>= 8;
-    }
-}
-
 // Print all valid positions for placing the disk
 void print_valid_positions(Move *moves, int color, int length)
 {
@@ -367,120 +264,155 @@ void print_move(Move move, int color)
 // Place a disk and return the number of disks which are flipped
 int place_disk_and_count_num_flips(Board *b, Move move, int color, int verbose)
 {
-    int number_of_legal_moves = FlipDisks(move, b, color, verbose, 1);
-    PlaceOrFlip(move, b, color);
-    return number_of_legal_moves;
+    if (verbose)
+        FlipDisks(move, b, color, verbose, 0);
+    return bb_popcount(play_square(b, BOARD_BIT_INDEX(move.row, move.col), color));
 }
 
-// Return the best action given board status and searching `depth` moves ahead for placing a `color` disk
-Action serial_negamax(Board b, int color, int depth)
+
+// Opening book mapped with -L, empty without one
+OpeningBook opening_book;
+
+// Persistent position cache of -C, shared across runs
+PositionCache position_cache;
+
+// Merge what this run added to the position cache into its file, at exit
+void merge_position_cache()
 {
-    if (depth == 0)
-    {
-        // If depth is 0, return the utility score of this move
-        Action best_action;
-        best_action.utility = utility(&b, color);
-        return best_action;
-    }
-    else
-    {
-        // Initialize essential variables and get valid positions for placing a new `color` disk
-        Board legal_moves;
-        int num_of_legal_moves = EnumerateLegalMoves(b, color, &legal_moves);
-        Move valid_positions[num_of_legal_moves];
-        get_valid_positions(&b, legal_moves.disks[color], color, valid_positions);
-
-        /*
-        Find the best position for placing a new `color` disk
-        The definition of best position depends on which player is placing in the computer turn
-        If player1 is placing in the initial computer turn, then player1 aims to maximize the
-        utiltiy score, while player2 tries to minimize player1's utility score
-        */
-        Action best_action;
-        best_action.utility = -100;
-        for (int i = 0; i < num_of_legal_moves; i++)
-        {
-            Board new_board = b;
-            place_disk_and_count_num_flips(&new_board, valid_positions[i], color, 0);
-            // Update best action
-            int current_utility = -serial_negamax(new_board, OTHERCOLOR(color), depth - 1).utility;
-            if (current_utility > best_action.utility)
-            {
-                best_action.move = valid_positions[i];
-                best_action.utility = current_utility;
-            }
-        }
+    if (!cache_merge(&position_cache))
+        perror(position_cache.path);
+}
+
+// Between searches: merge the results of this run into the cache file once there are many
+void checkpoint_position_cache()
+{
+    if (!cache_checkpoint(&position_cache))
+        perror(position_cache.path);
+}
+
+// Time budget per computer move in seconds, set with -m; 0 searches to the fixed depth
+double move_time = 0;
+
+// Print search statistics after every computer move, set with -s
+bool print_stats = false;
 
-        // If player is not movable, check if the other player can move
-        if (num_of_legal_moves == 0)
+// Root moves ranked per position by the batch analysis, set with -V; 0 gives the best move only
+int multipv_moves = 0;
+
+// Engine of the computer players of a game, and the positions it searched for them
+Engine *game_engine = NULL;
+ull game_nodes = 0;
+
+// Print how well the move ordering did in the last search
+void print_ordering_stats(const SearchResult *result)
+{
+    printf("Ordered %llu nodes, %llu cutoffs, %.1f%% of them on the first move\n", result->ordering.nodes,
+           result->ordering.cutoffs,
+           result->ordering.cutoffs ? 100.0 * result->ordering.first_move_cutoffs / result->ordering.cutoffs : 0.0);
+}
+
+// Print how many spawned children were stolen in the last search and the grain it ran with
+void print_grain_stats(const SearchResult *result)
+{
+    printf("Spawned %llu children, %.1f%% of them stolen, grain %.0f nodes\n", result->children,
+           result->children ? 100.0 * result->stolen / result->children : 0.0, result->grain);
+}
+
+// Print the search counters of the last search as one record for move `move_number`
+void print_search_stats(const SearchResult *result, int move_number, int color)
+{
+    stats_print_record(stdout, move_number, diskcolor[color + 1], result->seconds, &result->stats);
+}
+
+/*
+Pondering (-P): while a human player thinks over a move, the computer searches the
+replies it will have to answer. The human's legal moves are taken in the order of
+the move ordering heuristics, the most likely first, and the position after each
+is searched just as ComputerTurn would search it. Reading the move runs in a
+spawned strand, which blocks its worker in scanf while the other workers ponder;
+once the move is read, the ponder search is stopped. When the move played was
+pondered to the end, ComputerTurn answers with the result at once; otherwise the
+transposition table still holds what the ponder search found below it.
+*/
+#define PONDER_MAX_REPLIES 64
+
+typedef struct
+{
+    Board board; /* position after the human's reply, computer to move */
+    int depth;
+    SearchResult result; /* of the ponder search, printed by -s as the one of the move */
+} PonderResult;
+
+bool pondering = false;
+PonderResult ponder_results[PONDER_MAX_REPLIES];
+int nponder_results = 0;
+volatile bool ponder_move_read = false;
+
+// Find the pondered answer to the position `b`, searched `depth` ahead
+bool ponder_answer(Board b, int depth, SearchResult *result)
+{
+    for (int i = 0; i < nponder_results; i++)
+        if (ponder_results[i].board.disks[X_BLACK] == b.disks[X_BLACK] &&
+            ponder_results[i].board.disks[O_WHITE] == b.disks[O_WHITE] && ponder_results[i].depth == depth)
         {
-            // Both players cannot move return the utility score of this move
-            if (EnumerateLegalMoves(b, OTHERCOLOR(color), &legal_moves) == 0)
-                best_action.utility = utility(&b, color);
-            // The other player can move, then keep searching
-            else
-            {
-                best_action = serial_negamax(b, OTHERCOLOR(color), depth);
-                best_action.utility = -best_action.utility;
-            }
+            *result = ponder_results[i].result;
+            return true;
         }
-
-        return best_action;
-    };
+    return false;
 }
 
-// Return the best action given board status and searching `depth` moves ahead for placing a `color` disk
-Action parallel_negamax(Board b, int color, int depth)
+// Search the computer's answer to each of the human's replies in `b`, most likely first, until the move is read
+void ponder(Board b, int human, int depth)
 {
-    // Switch to the serial mode to increase granularity
-    if (depth <= 3)
-        return serial_negamax(b, color, depth);
-    else
+    int computer = OTHERCOLOR(human);
+    unsigned char squares[STACK_MAX_MOVES];
+    int nreplies = game_engine->ordered_moves(b, human, squares);
+    SearchLimits limits = {depth, 0, ENGINE_DEFAULT, 0};
+    for (int i = 0; i < nreplies && !ponder_move_read; i++)
     {
-        // Initialize essential variables and get valid positions for placing a new `color` disk
+        Board reply = b;
+        play_square(&reply, squares[i], human);
         Board legal_moves;
-        int num_of_legal_moves = EnumerateLegalMoves(b, color, &legal_moves);
-        Move valid_positions[num_of_legal_moves];
-        get_valid_positions(&b, legal_moves.disks[color], color, valid_positions);
-
-        /*
-        Use reducer to find the best position for placing a new `color` disk
-        The definition of best position depends on which player is placing in the computer turn
-        If player1 is placing in the initial computer turn, then player1 aims to maximize the
-        utiltiy score, while player2 tries to minimize player1's utility score
-        */
-        cilk::reducer_max_index<int, int> max_reducer;
-        cilk_for(int i = 0; i < num_of_legal_moves; i++)
-        {
-            Board new_board = b;
-            place_disk_and_count_num_flips(&new_board, valid_positions[i], color, 0);
-            // Update max score
-            max_reducer.calc_max(i, -parallel_negamax(new_board, OTHERCOLOR(color), depth - 1).utility);
-        }
+        if (EnumerateLegalMoves(reply, computer, &legal_moves) == 0)
+            continue;
+        game_engine->set_position(reply, computer);
+        SearchResult result = game_engine->ponder(limits);
+        game_nodes += result.nodes;
+        if (ponder_move_read)
+            break;
+        if (result.source == SEARCH_BOOK)
+            continue;
+        PonderResult *pondered = &ponder_results[nponder_results++];
+        pondered->board = reply;
+        pondered->depth = depth;
+        pondered->result = result;
+    }
+}
 
-        Action best_action;
-        // If player is not movable, check if the other player can move
-        if (num_of_legal_moves == 0)
-        {
-            // Both players cannot move return the utility score of this move
-            if (EnumerateLegalMoves(b, OTHERCOLOR(color), &legal_moves) == 0)
-                best_action.utility = utility(&b, color);
-            // The other player can move, then keep searching
-            else
-            {
-                best_action = parallel_negamax(b, OTHERCOLOR(color), depth);
-                best_action.utility = -best_action.utility;
-            }
-        }
-        else
-        {
-            // Finish searching at this depth, return best move for this board status
-            best_action.move = valid_positions[max_reducer.get_index()];
-            best_action.utility = max_reducer.get_value();
-        }
+// Read the human's move, then stop the ponder search
+void read_move_and_stop_pondering(int color, Board *b)
+{
+    ReadMove(color, b);
+    ponder_move_read = true;
+    game_engine->stop();
+}
+
+// HumanTurn, pondering the answers of a computer opponent that searches `depth` ahead (0 for no pondering)
+bool HumanTurnPondering(Board *b, int color, int depth)
+{
+    Board legal_moves;
+    if (depth == 0 || !pondering || EnumerateLegalMoves(*b, color, &legal_moves) == 0)
+        return HumanTurn(b, color);
 
-        return best_action;
-    };
+    Board before = *b;
+    nponder_results = 0;
+    ponder_move_read = false;
+    game_engine->resume();
+    cilk_spawn read_move_and_stop_pondering(color, b);
+    ponder(before, color, depth);
+    cilk_sync;
+    game_engine->resume();
+    return true;
 }
 
 // Computer Turn
@@ -490,9 +422,35 @@ bool ComputerTurn(Board *b, int color, int depth)
     // Check if there is no valid poisitons for placing a new `color` disk
     if (EnumerateLegalMoves(*b, color, &legal_moves) != 0)
     {
-        // Find the best position for placing a new `color` disk
-        Action computer_action = parallel_negamax(*b, color, depth);
+        // Find the best position for placing a new `color` disk, reusing what the table kept from earlier moves
+        SearchResult result = SearchResult();
+        int empties = board_empties(*b);
+        if (move_time == 0 && ponder_answer(*b, depth, &result))
+            printf("Computer answered from the ponder search: %+d for %c\n", result.action.utility, diskcolor[color + 1]);
+        else
+        {
+            SearchLimits limits = {depth, move_time, ENGINE_DEFAULT, 0};
+            game_engine->set_position(*b, color);
+            result = game_engine->search(limits);
+            game_nodes += result.nodes;
+            if (result.source == SEARCH_BOOK)
+                printf("Computer found the move in the opening book: searched %d moves ahead, %+d for %c\n", result.depth,
+                       result.action.utility, diskcolor[color + 1]);
+            else if (result.source == SEARCH_SOLVED)
+                printf("Computer solved the endgame: exact final disk differential for %c is %+d\n", diskcolor[color + 1],
+                       result.action.utility);
+            else if (result.source == SEARCH_TIMED)
+                printf("Computer searched to depth %d in %.3f seconds\n", result.depth, result.seconds);
+        }
+        Action computer_action = result.action;
         printf("Computer have placed %c in [row %d, column %d]\n", diskcolor[color + 1], computer_action.move.row, computer_action.move.col);
+        if (print_stats)
+        {
+            print_ordering_stats(&result);
+            STATS(print_search_stats(&result, 61 - empties, color));
+            print_grain_stats(&result);
+        }
+        checkpoint_position_cache();
 
         // Flip disks and place a new `color` disk
         int nflips = place_disk_and_count_num_flips(b, computer_action.move, color, 1);
@@ -519,14 +477,911 @@ void handle_input(int id, char &player, int &depth)
     }
 }
 
+/*
+Batch analysis: score a stream of positions instead of playing a game.
+
+Text input has one position per line: 64 squares from row 1, column 1 to row 8,
+column 8 ('X' or '*' black, 'O' white, '-' or '.' empty, spaces ignored) followed
+by the side to move, 'X' or 'O'. Blank lines and lines starting with '#' are skipped.
+Binary input is a sequence of 17-byte records: the black and the white disks as
+little-endian 64-bit words in the BOARD_BIT_INDEX layout, then the side to move
+(0 black, 1 white).
+
+Positions are read in chunks and every chunk is analyzed concurrently, one
+position per strand, so the workers share both positions and the trees below
+them. One line is written per position, in input order:
+    <number> <row>,<col>|pass|over <score> <depth> exact|search
+where the score is the disk differential for the side to move. With -V K the best
+K moves of a position are ranked instead (see multi_pv), one line per move:
+    <number> <rank> <score> <depth> exact|search <principal variation>
+where the principal variation starts with the move itself and lists the moves
+as <row>,<col> or pass. A position whose side to move has to pass gets the
+usual line.
+*/
+#define BATCH_TEXT 0
+#define BATCH_BINARY 1
+#define BATCH_RECORD_BYTES 17
+
+/* positions per worker in a chunk of fixed-depth searches; more than one evens out the load */
+#define BATCH_POSITIONS_PER_WORKER 4
+
+#define BATCH_DEFAULT_DEPTH 8
+
+// Blank lines and lines starting with '#' carry no position
+bool is_comment_line(const char *line)
+{
+    while (*line == ' ' || *line == '\t')
+        line++;
+    return *line == '#' || *line == '\n' || *line == '\r' || *line == '\0';
+}
+
+// Read the next position of a text stream; false at end of input. `line_number` counts the lines read.
+bool read_text_position(FILE *in, Board *b, int *color, int *line_number)
+{
+    char line[256];
+    while (fgets(line, sizeof(line), in))
+    {
+        (*line_number)++;
+        if (is_comment_line(line))
+            continue;
+        if (parse_position(line, b, color))
+            return true;
+        fprintf(stderr, "line %d: not a position, skipped\n", *line_number);
+    }
+    return false;
+}
+
+// Read the next 17-byte record of a binary stream; false at end of input
+bool read_binary_position(FILE *in, Board *b, int *color)
+{
+    unsigned char record[BATCH_RECORD_BYTES];
+    if (fread(record, 1, BATCH_RECORD_BYTES, in) != BATCH_RECORD_BYTES)
+        return false;
+    b->disks[X_BLACK] = b->disks[O_WHITE] = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        b->disks[X_BLACK] = (b->disks[X_BLACK] << 8) | record[i];
+        b->disks[O_WHITE] = (b->disks[O_WHITE] << 8) | record[8 + i];
+    }
+    *color = record[16] ? O_WHITE : X_BLACK;
+    return true;
+}
+
+void print_analysis(FILE *out, long number, const SearchResult *a)
+{
+    for (size_t i = 0; i < a->lines.size(); i++)
+    {
+        const RootMove *line = &a->lines[i];
+        fprintf(out, "%ld %zu %+d %d %s", number, i + 1, line->score, a->depth, a->exact ? "exact" : "search");
+        for (int ply = 0; ply < line->npv; ply++)
+        {
+            if (line->pv[ply] == MULTIPV_PASS)
+                fprintf(out, " pass");
+            else
+                fprintf(out, " %d,%d", BB_SQUARE_ROW(line->pv[ply]), BB_SQUARE_COL(line->pv[ply]));
+        }
+        fprintf(out, "\n");
+    }
+    if (!a->lines.empty())
+        return;
+
+    fprintf(out, "%ld ", number);
+    if (a->depth == 0)
+        fprintf(out, "over");
+    else if (a->action.move.row == 0)
+        fprintf(out, "pass");
+    else
+        fprintf(out, "%d,%d", a->action.move.row, a->action.move.col);
+    fprintf(out, " %+d %d %s\n", a->action.utility, a->depth, a->exact ? "exact" : "search");
+}
+
+/*
+Analyze every position of `in` (BATCH_TEXT or BATCH_BINARY `format`) and write the
+results to `out` with `engine`. With a time budget per position (-m) a chunk holds
+one position per worker and all of them deepen until the same deadline. Return the
+number of positions analyzed.
+*/
+long run_batch(Engine *engine, FILE *in, int format, FILE *out, int depth)
+{
+    int nworkers = __cilkrts_get_nworkers();
+    int chunk_size = (move_time > 0) ? nworkers : nworkers * BATCH_POSITIONS_PER_WORKER;
+    vector<Analysis> chunk(chunk_size);
+    long analyzed = 0;
+    int line_number = 0;
+    double begin = now_seconds();
+    SearchLimits limits = {depth, move_time, ENGINE_DEFAULT, multipv_moves};
+
+    for (;;)
+    {
+        int n = 0;
+        while (n < chunk_size &&
+               (format == BATCH_BINARY ? read_binary_position(in, &chunk[n].board, &chunk[n].color)
+                                       : read_text_position(in, &chunk[n].board, &chunk[n].color, &line_number)))
+            n++;
+        if (n == 0)
+            break;
+
+        engine->analyze(chunk.data(), n, limits);
+        checkpoint_position_cache();
+
+        for (int i = 0; i < n; i++)
+            print_analysis(out, analyzed + i + 1, &chunk[i].result);
+        fflush(out);
+        analyzed += n;
+    }
+
+    double seconds = now_seconds() - begin;
+    fprintf(stderr, "analyzed %ld positions in %.3f seconds, %.1f positions/sec\n", analyzed, seconds,
+            seconds > 0 ? analyzed / seconds : 0.0);
+    return analyzed;
+}
+
+/*
+Opening book builder (-M): expand the game tree from the start position `plies`
+moves deep, search every position of it `depth` moves ahead and write the best
+moves to a book file (book.h). The tree is expanded one ply at a time; a position
+reached by several move orders, or an image of it under a symmetry of the board
+(symmetry.h), is searched once, and the positions of a ply are
+analyzed concurrently, like a chunk of a batch. A side without a move has no book
+entry; the next ply continues with its opponent to move.
+*/
+#define BOOK_DEFAULT_PLIES 6
+
+// Key of the canonical form of the position of `a`, the same for all its images
+ull analysis_key(const Analysis &a)
+{
+    int symmetry;
+    return symmetry_key(a.board.disks[a.color], a.board.disks[OTHERCOLOR(a.color)], a.color, &symmetry);
+}
+
+bool analysis_key_less(const Analysis &a, const Analysis &b)
+{
+    return analysis_key(a) < analysis_key(b);
+}
+
+bool analysis_same_key(const Analysis &a, const Analysis &b)
+{
+    return analysis_key(a) == analysis_key(b);
+}
+
+// Build the book `file` from the positions up to `plies` moves from the start with `engine`; false if it cannot be written
+bool build_book(Engine *engine, const char *file, int plies, int depth)
+{
+    vector<Analysis> level(1);
+    level[0].board = start;
+    level[0].color = X_BLACK;
+    vector<BookEntry> entries;
+    double begin = now_seconds();
+    SearchLimits limits = {depth, 0, ENGINE_DEFAULT, 0};
+
+    for (int ply = 0; ply <= plies && !level.empty(); ply++)
+    {
+        sort(level.begin(), level.end(), analysis_key_less);
+        level.erase(unique(level.begin(), level.end(), analysis_same_key), level.end());
+        engine->analyze(level.data(), (int)level.size(), limits);
+        checkpoint_position_cache();
+
+        vector<Analysis> next;
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            Analysis *a = &level[i];
+            Analysis child = *a;
+            child.color = OTHERCOLOR(a->color);
+            if (a->result.depth == 0)
+                continue;
+            if (a->result.action.move.row == 0)
+            {
+                if (ply < plies)
+                    next.push_back(child);
+                continue;
+            }
+            Move move = a->result.action.move;
+            entries.push_back(book_entry(a->board.disks[a->color], a->board.disks[child.color], a->color,
+                                         a->result.action.utility, BOARD_BIT_INDEX(move.row, move.col), a->result.depth));
+            if (ply == plies)
+                continue;
+            ull own = a->board.disks[a->color], opp = a->board.disks[child.color];
+            for (ull moves = symmetry_unique_moves(own, opp, bb_kernel.legal_moves(own, opp)); moves; moves &= moves - 1)
+            {
+                child.board = a->board;
+                play_square(&child.board, bb_first_square(moves), a->color);
+                next.push_back(child);
+            }
+        }
+        fprintf(stderr, "ply %d: %zu positions searched, %zu in the book, %.3f seconds\n", ply, level.size(),
+                entries.size(), now_seconds() - begin);
+        level.swap(next);
+    }
+    return book_write(file, entries);
+}
+
+/*
+Tournament: play many games between two computer players in one process instead
+of one game per process.
+
+A player is given as engine:depth[:milliseconds], e.g. alphabeta:6, negamax:4, or
+alphabeta:60:50 for 50 ms per move with the depth as a cap (a timed player deepens
+alpha-beta, as -m does). Games are played in pairs from the same opening, player 1
+taking black in the first game of a pair and white in the second, so an opening
+that favors one color favors neither player. Openings are the positions of a file
+in the batch text format, used in turn, or a few random legal moves from the start
+position, seeded by the pair so that a tournament can be replayed.
+
+The games move in phases: every game where player 1 is to move searches its move
+at once, one strand per game, then every game where player 2 is. The searches of
+a phase share the player's settings, its deadline and the workers: the spawns below
+each game go to the same pool as the games themselves. While many games are in
+play, game-level parallelism keeps the workers busy, few children are stolen and
+the adaptive grain (grain.h) grows until the searches run serially; as games end
+and the phases thin out, steals rise, the grain shrinks and the searches spread
+over the idle workers again. Each player searches with an engine of its own
+(engine.h), so neither profits from the other's searches, and its table starts
+empty in every phase; the position cache of -C is not used, for the same reason.
+
+One line is written per game, in game order:
+    <game> <opening> <black player> <final disk differential for black>
+followed by a line per player: wins, draws, losses and the average nodes and
+seconds of its moves.
+*/
+#define TOURNAMENT_DEFAULT_DEPTH 4
+#define TOURNAMENT_DEFAULT_RANDOM_PLIES 4
+
+typedef struct
+{
+    const char *name; /* engine:depth[:milliseconds] as given */
+    int engine;       /* ENGINE_ALPHABETA, ENGINE_NEGAMAX or ENGINE_LAZY_SMP */
+    int depth;
+    double move_time; /* seconds per move, 0 searches to `depth` */
+    int wins, draws, losses;
+    long moves;
+    ull nodes;
+    double seconds; /* summed over the moves */
+} Player;
+
+typedef struct
+{
+    Board board;
+    int color;  /* side to move */
+    int black;  /* player with the black disks, 0 or 1 */
+    int opening;
+    bool over;
+} Game;
+
+// Parse a player given as engine:depth[:milliseconds]; return false if `text` is not one
+bool parse_player(const char *text, Player *player)
+{
+    char engine[16];
+    int milliseconds = 0;
+    int n = sscanf(text, "%15[a-z]:%d:%d", engine, &player->depth, &milliseconds);
+    if (n < 2 || player->depth < 1 || milliseconds < 0 || !parse_engine(engine, &player->engine))
+        return false;
+    player->name = text;
+    player->move_time = milliseconds / 1000.0;
+    return true;
+}
+
+// Play `plies` random legal moves from the start position; the same `seed` gives the same moves
+void random_opening(Board *b, int *color, int plies, unsigned seed)
+{
+    *b = start;
+    *color = X_BLACK;
+    for (int i = 0; i < plies; i++)
+    {
+        ull moves = bb_kernel.legal_moves(b->disks[*color], b->disks[OTHERCOLOR(*color)]);
+        if (moves)
+        {
+            for (int skip = rand_r(&seed) % bb_popcount(moves); skip > 0; skip--)
+                moves &= moves - 1;
+            play_square(b, bb_first_square(moves), *color);
+        }
+        *color = OTHERCOLOR(*color);
+    }
+}
+
+// Pass for a side without a move; return false if neither side has one and the game is over
+bool settle_game(Game *game)
+{
+    Board legal_moves;
+    if (EnumerateLegalMoves(game->board, game->color, &legal_moves) != 0)
+        return true;
+    game->color = OTHERCOLOR(game->color);
+    return EnumerateLegalMoves(game->board, game->color, &legal_moves) != 0;
+}
+
+// Player (0 or 1) to move in `game`
+int game_player(const Game *game)
+{
+    return (game->color == X_BLACK) ? game->black : 1 - game->black;
+}
+
+// Score a finished game for both players
+void record_result(Player *players, const Game *game)
+{
+    Board board = game->board;
+    int differential = utility(&board, X_BLACK);
+    Player *black = &players[game->black], *white = &players[1 - game->black];
+    if (differential == 0)
+    {
+        black->draws++;
+        white->draws++;
+    }
+    else
+    {
+        (differential > 0 ? black : white)->wins++;
+        (differential > 0 ? white : black)->losses++;
+    }
+}
+
+/*
+Play `ngames` games between `players`, each with an engine of `config`, from the
+openings of `book` (NULL for `random_plies` random moves), write the results to
+`out`. Return false if the book has no position.
+*/
+bool run_tournament(Player *players, const EngineConfig &config, int ngames, FILE *book, int random_plies, FILE *out)
+{
+    vector<Game> openings;
+    Game opening;
+    int line_number = 0;
+    while (book && read_text_position(book, &opening.board, &opening.color, &line_number))
+        openings.push_back(opening);
+    if (book && openings.empty())
+        return false;
+
+    vector<Game> games(ngames);
+    for (int g = 0; g < ngames; g++)
+    {
+        Game *game = &games[g];
+        game->opening = g / 2;
+        if (book)
+        {
+            game->board = openings[game->opening % openings.size()].board;
+            game->color = openings[game->opening % openings.size()].color;
+        }
+        else
+            random_opening(&game->board, &game->color, random_plies, game->opening + 1);
+        game->black = g % 2;
+        game->over = false;
+    }
+
+    EngineConfig player_config = config;
+    player_config.fresh_search = true;
+    player_config.cache = NULL;
+    Engine engine1(player_config), engine2(player_config);
+    Engine *engines[2] = {&engine1, &engine2};
+
+    double begin = now_seconds();
+    vector<int> movers(ngames);
+    vector<Analysis> phase(ngames); /* the positions of the games that move in this phase */
+    int playing = ngames;
+    for (int p = 0; playing > 0; p = 1 - p)
+    {
+        int n = 0;
+        for (int g = 0; g < ngames; g++)
+        {
+            if (games[g].over)
+                continue;
+            if (!settle_game(&games[g]))
+            {
+                games[g].over = true;
+                record_result(players, &games[g]);
+                playing--;
+            }
+            else if (game_player(&games[g]) == p)
+            {
+                phase[n].board = games[g].board;
+                phase[n].color = games[g].color;
+                movers[n++] = g;
+            }
+        }
+        if (n == 0)
+            continue;
+
+        Player *player = &players[p];
+        SearchLimits limits = {player->depth, player->move_time, player->engine, 0};
+        player->nodes += engines[p]->analyze(phase.data(), n, limits);
+
+        player->moves += n;
+        for (int i = 0; i < n; i++)
+        {
+            Game *game = &games[movers[i]];
+            Move move = phase[i].result.action.move;
+            play_square(&game->board, BOARD_BIT_INDEX(move.row, move.col), game->color);
+            game->color = OTHERCOLOR(game->color);
+            player->seconds += phase[i].result.seconds;
+        }
+    }
+    double seconds = now_seconds() - begin;
+
+    for (int g = 0; g < ngames; g++)
+        fprintf(out, "%d %d %d %+d\n", g + 1, games[g].opening + 1, games[g].black + 1, utility(&games[g].board, X_BLACK));
+    for (int p = 0; p < 2; p++)
+    {
+        Player *player = &players[p];
+        fprintf(out, "player %d %s: %d wins, %d draws, %d losses, %.0f nodes/move, %.6f seconds/move\n", p + 1,
+                player->name, player->wins, player->draws, player->losses,
+                player->moves ? (double)player->nodes / player->moves : 0.0,
+                player->moves ? player->seconds / player->moves : 0.0);
+    }
+    long moves = players[0].moves + players[1].moves;
+    fprintf(stderr, "played %d games, %ld moves in %.3f seconds, %.2f games/sec, %.1f moves/sec\n", ngames, moves,
+            seconds, seconds > 0 ? ngames / seconds : 0.0, seconds > 0 ? moves / seconds : 0.0);
+    return true;
+}
+
+/*
+Benchmark: search a fixed set of positions with every engine and report nodes,
+wall time, nodes per second, the speedup over 1 worker and the node overhead
+(nodes over those of the 1-worker search), as CSV or JSON.
+
+The positions file (bench_positions.txt) has one position per line:
+    <name> <negamax depth> <alpha-beta depth> <64 squares> <side to move> [<engine>=<nodes> ...]
+the full-width negamax searches get a shallower depth than alpha-beta, so that
+both take a measurable but bounded time. The node counts are the reference for 1 worker with the default table size and
+move ordering. Every search starts from an empty table and fresh move ordering,
+so a 1-worker run visits exactly the same nodes every time; a different count
+means the search itself changed, and the benchmark fails. With more workers the
+parallel searches race for the table and cutoffs, so their counts are not checked.
+*/
+#define BENCH_MAX_POSITIONS 64
+#define BENCH_MAX_WORKER_COUNTS 16
+
+typedef struct
+{
+    char name[32];
+    int depth[2]; /* full-width and pruning engines */
+    Board board;
+    int color;
+    char expected[256]; /* the <engine>=<nodes> fields */
+} BenchPosition;
+
+typedef struct
+{
+    const char *name;
+    bool parallel; /* run at every worker count, not just 1 */
+    bool pruning;  /* searches the alpha-beta depth of the positions */
+    int engine;    /* ENGINE_* */
+} BenchEngine;
+
+BenchEngine bench_engines[] = {
+    {"serial_negamax_generic", false, false, ENGINE_SERIAL_NEGAMAX_GENERIC},
+    {"serial_negamax", false, false, ENGINE_SERIAL_NEGAMAX},
+    {"parallel_negamax", true, false, ENGINE_NEGAMAX},
+    {"parallel_alphabeta", true, true, ENGINE_ALPHABETA},
+    {"lazy_smp", true, true, ENGINE_LAZY_SMP}};
+int bench_nengines = sizeof(bench_engines) / sizeof(BenchEngine);
+
+// Read the benchmark positions; return how many there are, or -1 if the file cannot be read
+int read_bench_positions(const char *file, BenchPosition *positions)
+{
+    FILE *in = fopen(file, "r");
+    if (in == NULL)
+        return -1;
+    char line[512];
+    int n = 0, line_number = 0;
+    while (n < BENCH_MAX_POSITIONS && fgets(line, sizeof(line), in))
+    {
+        line_number++;
+        if (is_comment_line(line))
+            continue;
+        BenchPosition *p = &positions[n];
+        int length;
+        const char *rest = NULL;
+        if (sscanf(line, "%31s %d %d %n", p->name, &p->depth[0], &p->depth[1], &length) == 3)
+            rest = parse_position(line + length, &p->board, &p->color);
+        if (rest == NULL)
+        {
+            fprintf(stderr, "%s:%d: not a benchmark position\n", file, line_number);
+            fclose(in);
+            return -1;
+        }
+        snprintf(p->expected, sizeof(p->expected), "%s", rest);
+        n++;
+    }
+    fclose(in);
+    return n;
+}
+
+// Find the reference node count of `engine` among the <engine>=<nodes> fields
+bool bench_expected_nodes(const char *fields, const char *engine, ull *nodes)
+{
+    size_t length = strlen(engine);
+    for (const char *p = strstr(fields, engine); p; p = strstr(p + 1, engine))
+        if ((p == fields || p[-1] == ' ' || p[-1] == '\t') && p[length] == '=')
+            return sscanf(p + length + 1, "%llu", nodes) == 1;
+    return false;
+}
+
+// Restart the Cilk runtime with `nworkers` workers
+bool bench_set_workers(int nworkers)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%d", nworkers);
+    __cilkrts_end_cilk();
+    return __cilkrts_set_param("nworkers", text) == 0;
+}
+
+// `overhead` is the ratio of the nodes to those of the same search on 1 worker
+void print_bench_row(bool json, bool *first_row, const char *engine, int workers, const char *position, int depth,
+                     ull nodes, double seconds, double speedup, double overhead)
+{
+    double nps = seconds > 0 ? nodes / seconds : 0;
+    if (json)
+    {
+        printf("%s\n  {\"engine\": \"%s\", \"workers\": %d, \"position\": \"%s\", \"depth\": %d, \"nodes\": %llu, "
+               "\"seconds\": %.6f, \"nps\": %.0f, \"speedup\": %.3f, \"overhead\": %.3f}",
+               *first_row ? "" : ",", engine, workers, position, depth, nodes, seconds, nps, speedup, overhead);
+    }
+    else
+        printf("%s,%d,%s,%d,%llu,%.6f,%.0f,%.3f,%.3f\n", engine, workers, position, depth, nodes, seconds, nps, speedup,
+               overhead);
+    *first_row = false;
+}
+
+/*
+Run the benchmark of `file` at each of the `ncounts` worker counts in `worker_counts`
+(the first must be 1), with an engine of `config` that neither plays from a book nor
+solves the endgame. Return the number of node counts that differ from the reference.
+*/
+int run_bench(const char *file, const int *worker_counts, int ncounts, bool json, const EngineConfig &config)
+{
+    static BenchPosition positions[BENCH_MAX_POSITIONS];
+    int npositions = read_bench_positions(file, positions);
+    if (npositions < 0)
+    {
+        fprintf(stderr, "cannot read the benchmark positions in %s\n", file);
+        return 1;
+    }
+
+    EngineConfig bench_config = config;
+    bench_config.endgame_empties = 0;
+    bench_config.book = NULL;
+    bench_config.cache = NULL;
+    Engine searcher(bench_config);
+
+    double base_seconds[BENCH_MAX_POSITIONS + 1]; /* 1-worker times, the last one is the total */
+    ull base_nodes[BENCH_MAX_POSITIONS + 1];
+    int mismatches = 0;
+    bool first_row = true;
+    if (json)
+        printf("[");
+    else
+        printf("engine,workers,position,depth,nodes,seconds,nps,speedup,overhead\n");
+    for (int e = 0; e < bench_nengines; e++)
+    {
+        BenchEngine *engine = &bench_engines[e];
+        for (int c = 0; c < (engine->parallel ? ncounts : 1); c++)
+        {
+            int workers = worker_counts[c];
+            if (!bench_set_workers(workers))
+            {
+                fprintf(stderr, "cannot run with %d workers\n", workers);
+                return 1;
+            }
+            ull total_nodes_searched = 0;
+            double total_seconds = 0;
+            for (int i = 0; i < npositions; i++)
+            {
+                BenchPosition *p = &positions[i];
+                int depth = p->depth[engine->pruning];
+                SearchLimits limits = {depth, 0, engine->engine, 0};
+                searcher.new_game();
+                searcher.set_position(p->board, p->color);
+                SearchResult result = searcher.search(limits);
+                double seconds = result.seconds;
+                ull nodes = result.nodes;
+                total_nodes_searched += nodes;
+                total_seconds += seconds;
+                if (workers == 1)
+                {
+                    base_seconds[i] = seconds;
+                    base_nodes[i] = nodes;
+                }
+                print_bench_row(json, &first_row, engine->name, workers, p->name, depth, nodes, seconds,
+                                seconds > 0 ? base_seconds[i] / seconds : 0, base_nodes[i] ? (double)nodes / base_nodes[i] : 0);
+
+                ull expected;
+                if (workers == 1 && bench_expected_nodes(p->expected, engine->name, &expected) && expected != nodes)
+                {
+                    fprintf(stderr, "%s %s: searched %llu nodes, the reference is %llu\n", engine->name, p->name, nodes, expected);
+                    mismatches++;
+                }
+            }
+            if (workers == 1)
+            {
+                base_seconds[npositions] = total_seconds;
+                base_nodes[npositions] = total_nodes_searched;
+            }
+            print_bench_row(json, &first_row, engine->name, workers, "total", 0, total_nodes_searched, total_seconds,
+                            total_seconds > 0 ? base_seconds[npositions] / total_seconds : 0,
+                            base_nodes[npositions] ? (double)total_nodes_searched / base_nodes[npositions] : 0);
+        }
+    }
+    printf(json ? "\n]\n" : "");
+    if (mismatches)
+        fprintf(stderr, "%d node counts differ from %s\n", mismatches, file);
+    return mismatches;
+}
+
+// Parse a list of worker counts separated by commas or spaces into `counts`, 1 first; return how many there are
+int parse_worker_counts(const char *text, int *counts)
+{
+    int n = 0;
+    counts[n++] = 1;
+    while (*text && n < BENCH_MAX_WORKER_COUNTS)
+    {
+        char *end;
+        long count = strtol(text, &end, 10);
+        if (end == text)
+            return 0;
+        if (count > 1)
+            counts[n++] = (int)count;
+        text = end + strspn(end, ", ");
+    }
+    return n;
+}
+
+void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-b|-B positions_file] [-C cache_file] [-c cache_megabytes] [-d depth] [-e alphabeta|negamax|lazysmp] [-f] [-g grain] [-m milliseconds] [-o ordering] [-P] [-s] [-t table_megabytes] [-V moves|all] [-x empties]\n", program);
+    fprintf(stderr, "       %s -k bench_positions_file [-j] [-w worker_counts]\n", program);
+    fprintf(stderr, "       %s -M book_file [-d depth] [-p plies] [-g grain] [-t table_megabytes] [-x empties]\n", program);
+    fprintf(stderr, "       %s -T games [-1 player] [-2 player] [-O openings_file | -R plies] [-g grain] [-t table_megabytes] [-x empties]\n", program);
+    fprintf(stderr, "  -1  player 1 of the tournament as engine:depth[:milliseconds] (default alphabeta:%d)\n", TOURNAMENT_DEFAULT_DEPTH);
+    fprintf(stderr, "  -2  player 2 of the tournament, the same way\n");
+    fprintf(stderr, "  -b  analyze the positions of a text file (- for stdin) instead of playing a game\n");
+    fprintf(stderr, "  -B  the same for a file of 17-byte binary records\n");
+    fprintf(stderr, "  -C  keep exact results of deep searches and solved endgames in this file across runs\n");
+    fprintf(stderr, "  -c  size cap of the -C file in MB (default %d)\n", CACHE_DEFAULT_MEGABYTES);
+    fprintf(stderr, "  -d  search depth of the batch analysis (default %d, no limit with -m)\n", BATCH_DEFAULT_DEPTH);
+    fprintf(stderr, "  -e  parallel search engine (default alphabeta)\n");
+    fprintf(stderr, "  -f  start every computer move from an empty transposition table\n");
+    fprintf(stderr, "  -g  grain size: fixed (serial at depth <= %d), adaptive (default) or a number of nodes\n", GRAIN_FIXED_DEPTH);
+    fprintf(stderr, "  -j  print the benchmark as JSON instead of CSV\n");
+    fprintf(stderr, "  -k  benchmark every engine on the positions of the file, exit 1 if a node count changed\n");
+    fprintf(stderr, "  -L  play the moves of this opening book (built with -M) instead of searching them\n");
+    fprintf(stderr, "  -M  build an opening book of the positions up to -p moves from the start, searched\n");
+    fprintf(stderr, "      -d moves ahead (default %d)\n", BATCH_DEFAULT_DEPTH);
+    fprintf(stderr, "  -m  time per computer move; the depth entered becomes the maximum depth of an\n");
+    fprintf(stderr, "      iterative deepening alpha-beta search\n");
+    fprintf(stderr, "  -O  tournament openings: a file of positions in the -b text format, used in turn\n");
+    fprintf(stderr, "  -o  move ordering: none, default or a list of hash,killers,history,static,mobility,shared\n");
+    fprintf(stderr, "  -P  ponder: search the answers to a human's moves while the human thinks\n");
+    fprintf(stderr, "  -p  depth of the opening tree in the book, in moves (default %d)\n", BOOK_DEFAULT_PLIES);
+    fprintf(stderr, "  -R  random moves from the start position of each tournament opening (default %d)\n", TOURNAMENT_DEFAULT_RANDOM_PLIES);
+    fprintf(stderr, "  -s  print search statistics after every computer move\n");
+    fprintf(stderr, "  -T  play this many games between two computer players concurrently, in pairs\n");
+    fprintf(stderr, "      from the same opening with the colors swapped\n");
+    fprintf(stderr, "  -t  transposition table size in MB, 0 disables it (default %d)\n", TT_DEFAULT_MEGABYTES);
+    fprintf(stderr, "  -V  rank this many (or all) moves of every -b position with exact scores and\n");
+    fprintf(stderr, "      principal variations, at the fixed depth -d (not with -m)\n");
+    fprintf(stderr, "  -w  worker counts of the benchmark, e.g. 1,2,4,8 (default 1 and the number of workers)\n");
+    fprintf(stderr, "  -x  solve the game exactly once this many squares are empty, 0 never (default %d)\n", ENDGAME_DEFAULT_EMPTIES);
+}
+
 int main(int argc, const char *argv[])
 {
+    // Handle command line options
+    EngineConfig config = engine_default_config();
+    const char *batch_file = NULL;
+    int batch_format = BATCH_TEXT;
+    int batch_depth = 0;
+    const char *bench_file = NULL;
+    const char *bench_workers = NULL;
+    bool bench_json = false;
+    int tournament_games = 0;
+    const char *tournament_book = NULL;
+    int random_plies = TOURNAMENT_DEFAULT_RANDOM_PLIES;
+    const char *book_file = NULL;
+    const char *new_book_file = NULL;
+    int book_plies = BOOK_DEFAULT_PLIES;
+    const char *cache_file = NULL;
+    size_t cache_megabytes = CACHE_DEFAULT_MEGABYTES;
+    char default_player[16];
+    snprintf(default_player, sizeof(default_player), "alphabeta:%d", TOURNAMENT_DEFAULT_DEPTH);
+    Player players[2] = {};
+    parse_player(default_player, &players[0]);
+    parse_player(default_player, &players[1]);
+    int opt;
+    while ((opt = getopt(argc, (char *const *)argv, "1:2:b:B:C:c:d:e:fg:jk:L:M:m:O:o:Pp:R:sT:t:V:w:x:")) != -1)
+    {
+        switch (opt)
+        {
+        case '1':
+        case '2':
+            if (!parse_player(optarg, &players[opt - '1']))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'b':
+        case 'B':
+            batch_file = optarg;
+            batch_format = (opt == 'B') ? BATCH_BINARY : BATCH_TEXT;
+            break;
+        case 'C':
+            cache_file = optarg;
+            break;
+        case 'c':
+            cache_megabytes = atoi(optarg);
+            break;
+        case 'd':
+            batch_depth = atoi(optarg);
+            break;
+        case 'e':
+            if (!parse_engine(optarg, &config.engine))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'f':
+            config.fresh_search = true;
+            break;
+        case 'g':
+            if (!grain_parse_policy(optarg, &config.grain_policy, &config.grain_nodes))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'j':
+            bench_json = true;
+            break;
+        case 'k':
+            bench_file = optarg;
+            break;
+        case 'L':
+            book_file = optarg;
+            break;
+        case 'M':
+            new_book_file = optarg;
+            break;
+        case 'm':
+            move_time = atoi(optarg) / 1000.0;
+            break;
+        case 'O':
+            tournament_book = optarg;
+            break;
+        case 'o':
+            if (!ordering_parse_policy(optarg, &config.ordering))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'P':
+            pondering = true;
+            break;
+        case 'p':
+            book_plies = atoi(optarg);
+            break;
+        case 'R':
+            random_plies = atoi(optarg);
+            break;
+        case 's':
+            print_stats = true;
+            break;
+        case 'T':
+            tournament_games = atoi(optarg);
+            break;
+        case 't':
+            config.table_megabytes = atoi(optarg);
+            break;
+        case 'V':
+        {
+            char *end;
+            multipv_moves = (strcmp(optarg, "all") == 0) ? MULTIPV_ALL : (int)strtol(optarg, &end, 10);
+            if (multipv_moves < 1 || (multipv_moves != MULTIPV_ALL && *end != '\0'))
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        }
+        case 'w':
+            bench_workers = optarg;
+            break;
+        case 'x':
+            config.endgame_empties = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // The moves are ranked to the fixed depth -d; a time budget would deepen for the best move alone
+    if (multipv_moves > 0 && move_time > 0)
+    {
+        fprintf(stderr, "-V ranks the moves at a fixed depth and cannot be combined with -m\n");
+        usage(argv[0]);
+        return 1;
+    }
+
+    // The board code of the front-end plays moves with the kernel of the library
+    engine_library_init();
+
+    if (bench_file)
+    {
+        int worker_counts[BENCH_MAX_WORKER_COUNTS] = {1, __cilkrts_get_nworkers()};
+        int ncounts = (worker_counts[1] > 1) ? 2 : 1;
+        if (bench_workers)
+            ncounts = parse_worker_counts(bench_workers, worker_counts);
+        if (ncounts == 0)
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        return run_bench(bench_file, worker_counts, ncounts, bench_json, config) ? 1 : 0;
+    }
+
+    if (cache_file)
+    {
+        cache_open(&position_cache, cache_file, cache_megabytes);
+        atexit(merge_position_cache);
+        config.cache = &position_cache;
+    }
+
+    if (book_file && !book_open(&opening_book, book_file))
+    {
+        fprintf(stderr, "%s is not an opening book\n", book_file);
+        return 1;
+    }
+
+    if (new_book_file)
+    {
+        Engine engine(config);
+        if (!build_book(&engine, new_book_file, book_plies, batch_depth ? batch_depth : BATCH_DEFAULT_DEPTH))
+        {
+            perror(new_book_file);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (tournament_games > 0)
+    {
+        FILE *book = NULL;
+        if (tournament_book && (book = fopen(tournament_book, "r")) == NULL)
+        {
+            perror(tournament_book);
+            return 1;
+        }
+        if (!run_tournament(players, config, tournament_games, book, random_plies, stdout))
+        {
+            fprintf(stderr, "no opening in %s\n", tournament_book);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (batch_file)
+    {
+        FILE *in = strcmp(batch_file, "-") == 0 ? stdin : fopen(batch_file, batch_format == BATCH_BINARY ? "rb" : "r");
+        if (in == NULL)
+        {
+            perror(batch_file);
+            return 1;
+        }
+        if (batch_depth == 0)
+            batch_depth = (move_time > 0) ? 60 : BATCH_DEFAULT_DEPTH;
+        Engine engine(config);
+        run_batch(&engine, in, batch_format, stdout, batch_depth);
+        return 0;
+    }
+
     // Handle input
     char player1, player2;
     int search_depth1, search_depth2;
     handle_input(1, player1, search_depth1);
     handle_input(2, player2, search_depth2);
 
+    // Only the computer players of a game play from the opening book
+    config.book = &opening_book;
+    Engine engine(config);
+    game_engine = &engine;
+
     // Initialize game state
     Board gameboard = start;
     bool is_player1_movable, is_player2_movable;
@@ -538,12 +1393,16 @@ int main(int argc, const char *argv[])
     // If both players are not movable -> break and call end game
     do
     {
-        is_player1_movable = (player1 == 'h') ? HumanTurn(&gameboard, X_BLACK) : ComputerTurn(&gameboard, X_BLACK, search_depth1);
-        is_player2_movable = (player2 == 'h') ? HumanTurn(&gameboard, O_WHITE) : ComputerTurn(&gameboard, O_WHITE, search_depth2);
+        is_player1_movable = (player1 == 'h') ? HumanTurnPondering(&gameboard, X_BLACK, (player2 == 'c') ? search_depth2 : 0)
+                                              : ComputerTurn(&gameboard, X_BLACK, search_depth1);
+        is_player2_movable = (player2 == 'h') ? HumanTurnPondering(&gameboard, O_WHITE, (player1 == 'c') ? search_depth1 : 0)
+                                              : ComputerTurn(&gameboard, O_WHITE, search_depth2);
     } while (is_player1_movable || is_player2_movable);
 
     // Game is over, compute final score
     EndGame(gameboard);
+    if (print_stats)
+        printf("Computer players searched %llu nodes\n", game_nodes);
 
     return 0;
 }
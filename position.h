@@ -0,0 +1,132 @@
+#ifndef POSITION_H
+#define POSITION_H
+
+#include "bitboard_simd.h"
+#include "transposition.h"
+
+/*
+incremental search position shared by the search engines.
+
+a position is seen from the side to move and keeps what the search asks about
+at every node up to date as moves are made and taken back, instead of
+recomputing it from the disks:
+    - the disk counts of both sides, so a leaf is scored without counting
+    - the number of empty squares, for the hand-off to the endgame solver
+    - the Zobrist hash of transposition.h, updated by the squares that changed
+position_make() plays a move in place and records what it changed in a
+PositionUndo, position_unmake() takes the move back from that record. a pass
+is its own inverse.
+*/
+
+typedef struct
+{
+    ull own; /* disks of the side to move */
+    ull opp;
+    ull key;   /* zobrist_hash() of the disks with `color` to move */
+    int color; /* side to move */
+    int own_disks;
+    int opp_disks;
+    int empties;
+} Position;
+
+typedef struct
+{
+    ull flips; /* disks flipped by the move */
+    ull key;   /* hash before the move */
+    int square;
+    int nflips;
+} PositionUndo;
+
+// Set up `p` from the disks of both colors with `color` to move
+static inline void position_set(Position *p, const ull disks[2], int color)
+{
+    p->own = disks[color];
+    p->opp = disks[1 - color];
+    p->key = zobrist_hash(disks, color);
+    p->color = color;
+    p->own_disks = bb_popcount(p->own);
+    p->opp_disks = bb_popcount(p->opp);
+    p->empties = 64 - p->own_disks - p->opp_disks;
+}
+
+// Disk differential for the side to move, the score of a leaf
+static inline int position_score(const Position *p)
+{
+    return p->own_disks - p->opp_disks;
+}
+
+static inline ull position_legal_moves(const Position *p)
+{
+    return bb_kernel.legal_moves(p->own, p->opp);
+}
+
+// Return true if the side to move has to pass but the game goes on
+static inline bool position_can_pass(const Position *p)
+{
+    return bb_kernel.legal_moves(p->opp, p->own) != 0;
+}
+
+/*
+play the legal move `sq` for the side to move and record in `undo` how to take
+it back. COLOR is the side to move when it is known at compile time (the hash
+keys of the mover are then a constant table), -1 reads it from `p`.
+*/
+template <int COLOR>
+static inline void position_make_as(Position *p, int sq, PositionUndo *undo)
+{
+    int color = (COLOR < 0) ? p->color : COLOR;
+    ull flips = bb_kernel.flip_mask(sq, p->own, p->opp);
+    int nflips = bb_popcount(flips);
+    undo->flips = flips;
+    undo->key = p->key;
+    undo->square = sq;
+    undo->nflips = nflips;
+
+    ull key = p->key ^ zobrist.side ^ zobrist.squares[color][sq];
+    for (; flips; flips &= flips - 1)
+        key ^= zobrist.flips[bb_first_square(flips)];
+    p->key = key;
+
+    ull own = p->own | undo->flips | BB_SQUARE_BIT(sq);
+    p->own = p->opp & ~undo->flips;
+    p->opp = own;
+    int own_disks = p->own_disks + nflips + 1;
+    p->own_disks = p->opp_disks - nflips;
+    p->opp_disks = own_disks;
+    p->empties--;
+    p->color = 1 - color;
+}
+
+static inline void position_make(Position *p, int sq, PositionUndo *undo)
+{
+    position_make_as<-1>(p, sq, undo);
+}
+
+// Take back the move recorded in `undo`, the last one made on `p`
+static inline void position_unmake(Position *p, const PositionUndo *undo)
+{
+    ull own = p->opp & ~(undo->flips | BB_SQUARE_BIT(undo->square));
+    p->opp = p->own | undo->flips;
+    p->own = own;
+    int own_disks = p->opp_disks - undo->nflips - 1;
+    p->opp_disks = p->own_disks + undo->nflips;
+    p->own_disks = own_disks;
+    p->empties++;
+    p->color = 1 - p->color;
+    p->key = undo->key;
+}
+
+// Hand the move to the opponent; passing again takes it back
+static inline void position_pass(Position *p)
+{
+    ull own = p->own;
+    p->own = p->opp;
+    p->opp = own;
+    int own_disks = p->own_disks;
+    p->own_disks = p->opp_disks;
+    p->opp_disks = own_disks;
+    p->color = 1 - p->color;
+    p->key ^= zobrist.side;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SEARCH_STACK_H
+#define SEARCH_STACK_H
+
+#include "position.h"
+
+/*
+preallocated search stack for the serial searches.
+
+a serial search keeps one frame per ply in a fixed array instead of allocating
+move lists at every node: frame[0] is the node the search started at, and the
+child of frame[i] is always frame[i + 1]. the position itself is one Position
+(see position.h) made and unmade in place; a frame holds the legal moves as
+square indices (one byte each, see bitboard.h), the undo record of the move
+being searched and the best score and move found so far.
+
+a serial search never spawns, so it runs to completion on the worker that
+started it, and one stack per worker is enough. the parallel searches keep
+their move lists in their own (Cilk) frames: a stolen continuation carries on
+with the parent's moves on another worker while the first worker goes on to
+other work.
+*/
+
+/* 60 moves plus a pass between any two of them */
+#define STACK_MAX_PLY 128
+#define STACK_MAX_MOVES 64
+#define STACK_NO_SQUARE 0xff
+#define STACK_MAX_WORKERS 64
+
+typedef struct
+{
+    PositionUndo undo; /* the move being searched */
+    int nmoves;
+    int score;          /* best score so far */
+    unsigned char best; /* its move, STACK_NO_SQUARE if none */
+    unsigned char moves[STACK_MAX_MOVES];
+} SearchFrame;
+
+typedef struct alignas(64)
+{
+    SearchFrame frames[STACK_MAX_PLY];
+} SearchStack;
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+search instrumentation: counters kept per worker and merged after every move.
+
+each worker owns one SearchStats, aligned to its own cache lines, so counting is
+a plain increment with no sharing between workers. the counters are:
+    - nodes per depth: positions searched, by the number of moves left (the
+      depth argument of the search), so index 0 counts the horizon
+    - leaves:        positions scored by utility() (horizon or game over)
+    - passes:        positions where the side to move had no legal move
+    - cutoffs:       beta cutoffs found by searching a move
+    - tt probes:     table lookups, how many found the position, and how many
+                     of those decided the position without a search
+    - endgame nodes: positions visited inside the exact endgame solver
+
+compiling with -DNO_SEARCH_STATS removes every counter: STATS(...) then expands
+to nothing. the plain count of positions searched (SearchResult.nodes) is not one
+of them and stays: the benchmark checks it against its reference counts and reports
+nodes per second with it, in every build. it costs one increment of the worker's own
+cache line per node.
+*/
+
+typedef unsigned long long ull;
+
+#ifdef NO_SEARCH_STATS
+#define STATS(statement)
+#else
+#define STATS(statement) statement
+#endif
+
+#define STATS_MAX_DEPTH 64
+#define STATS_MAX_WORKERS 64
+
+typedef struct alignas(64)
+{
+    ull nodes[STATS_MAX_DEPTH];
+    ull leaves;
+    ull passes;
+    ull cutoffs;
+    ull tt_probes;
+    ull tt_hits;
+    ull tt_cutoffs;
+    ull endgame_nodes;
+} SearchStats;
+
+static inline void stats_clear(SearchStats *workers)
+{
+    memset((void *)workers, 0, STATS_MAX_WORKERS * sizeof(SearchStats));
+}
+
+// Counters of one worker; the depth index is clamped so deep searches stay in bounds
+static inline void stats_node(SearchStats *s, int depth)
+{
+    s->nodes[(depth < STATS_MAX_DEPTH) ? depth : STATS_MAX_DEPTH - 1]++;
+}
+
+// Sum the counters of every worker into `total`
+static inline void stats_merge(const SearchStats *workers, SearchStats *total)
+{
+    memset((void *)total, 0, sizeof(SearchStats));
+    for (int w = 0; w < STATS_MAX_WORKERS; w++)
+    {
+        const SearchStats *s = &workers[w];
+        for (int d = 0; d < STATS_MAX_DEPTH; d++)
+            total->nodes[d] += s->nodes[d];
+        total->leaves += s->leaves;
+        total->passes += s->passes;
+        total->cutoffs += s->cutoffs;
+        total->tt_probes += s->tt_probes;
+        total->tt_hits += s->tt_hits;
+        total->tt_cutoffs += s->tt_cutoffs;
+        total->endgame_nodes += s->endgame_nodes;
+    }
+}
+
+static inline ull stats_total_nodes(const SearchStats *s)
+{
+    ull total = 0;
+    for (int d = 0; d < STATS_MAX_DEPTH; d++)
+        total += s->nodes[d];
+    return total;
+}
+
+/*
+effective branching factor: the children actually searched per expanded
+position, (nodes - 1) / (nodes - leaves). a full-width search averages the
+number of legal moves; good move ordering pushes alpha-beta towards its square
+root. passes count as positions with one child.
+*/
+static inline double stats_branching_factor(const SearchStats *s)
+{
+    ull nodes = stats_total_nodes(s);
+    return (nodes > s->leaves) ? (double)(nodes - 1) / (nodes - s->leaves) : 0.0;
+}
+
+/*
+print one move's counters as a single JSON line:
+{"move": 12, "color": "X", "seconds": ..., "nodes": ..., ..., "nodes_per_depth": [d0, d1, ...]}
+nodes_per_depth stops at the deepest depth searched.
+*/
+static inline void stats_print_record(FILE *out, int move_number, char color, double seconds, const SearchStats *s)
+{
+    ull nodes = stats_total_nodes(s);
+    int max_depth = STATS_MAX_DEPTH - 1;
+    while (max_depth > 0 && s->nodes[max_depth] == 0)
+        max_depth--;
+    fprintf(out, "{\"move\": %d, \"color\": \"%c\", \"seconds\": %.6f, \"nodes\": %llu, \"nps\": %.0f, "
+                 "\"leaves\": %llu, \"passes\": %llu, \"cutoffs\": %llu, \"branching_factor\": %.3f, "
+                 "\"tt_probes\": %llu, \"tt_hits\": %llu, \"tt_cutoffs\": %llu, \"endgame_nodes\": %llu, \"nodes_per_depth\": [",
+            move_number, color, seconds, nodes, seconds > 0 ? nodes / seconds : 0.0, s->leaves, s->passes, s->cutoffs,
+            stats_branching_factor(s), s->tt_probes, s->tt_hits, s->tt_cutoffs, s->endgame_nodes);
+    for (int d = 0; d <= max_depth; d++)
+        fprintf(out, "%s%llu", d ? ", " : "", s->nodes[d]);
+    fprintf(out, "]}\n");
+}
+
+#endif
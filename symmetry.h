@@ -0,0 +1,161 @@
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include "bitboard.h"
+#include "transposition.h"
+
+/*
+the 8 symmetries of the board (rotations and reflections) on bitboards.
+
+a symmetry is a number 0-7 made of three bits, applied in this order:
+    - 4: transpose, row and column swap places (bb_flip_diagonal)
+    - 2: flip the rows upside down (bb_flip_vertical)
+    - 1: mirror the columns (bb_mirror_horizontal)
+each is a handful of shifts and masks over the whole board; 0 is the identity.
+
+two positions that are images of each other under a symmetry have the same
+score, and their best moves are images of each other too. the canonical form of
+a position is its image with the smallest disks (own first, then opponent) over
+all 8 symmetries, so every image of a position has the same canonical form and
+the same canonical key. the opening book and the position cache store positions
+by canonical key and their moves in canonical squares, which folds mirrored
+openings and transpositions into one entry.
+
+the search uses the symmetries the position itself has: the start position is
+unchanged by 4 of them, and moves that are images of each other under one of
+those lead to equivalent positions, only one of which needs a search.
+*/
+
+#define SYMMETRY_COUNT 8
+
+/* nodes with fewer moves left are cheaper to search in full than to check for symmetry */
+#define SYMMETRY_MIN_DEPTH 4
+
+// Swap rows 1 and 8, 2 and 7, ...: the bytes of the board in reverse order
+static inline ull bb_flip_vertical(ull b)
+{
+    return __builtin_bswap64(b);
+}
+
+// Swap columns 1 and 8, 2 and 7, ...: the bits of every byte in reverse order
+static inline ull bb_mirror_horizontal(ull b)
+{
+    b = ((b >> 1) & 0x5555555555555555ULL) | ((b & 0x5555555555555555ULL) << 1);
+    b = ((b >> 2) & 0x3333333333333333ULL) | ((b & 0x3333333333333333ULL) << 2);
+    return ((b >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((b & 0x0f0f0f0f0f0f0f0fULL) << 4);
+}
+
+// Transpose: the disk of row r, column c moves to row c, column r (bit 8r + c to bit 8c + r)
+static inline ull bb_flip_diagonal(ull b)
+{
+    ull t = 0x0f0f0f0f00000000ULL & (b ^ (b << 28));
+    b ^= t ^ (t >> 28);
+    t = 0x3333000033330000ULL & (b ^ (b << 14));
+    b ^= t ^ (t >> 14);
+    t = 0x5500550055005500ULL & (b ^ (b << 7));
+    return b ^ t ^ (t >> 7);
+}
+
+// Image of the squares `b` under `symmetry`
+static inline ull symmetry_transform(ull b, int symmetry)
+{
+    if (symmetry & 4)
+        b = bb_flip_diagonal(b);
+    if (symmetry & 2)
+        b = bb_flip_vertical(b);
+    if (symmetry & 1)
+        b = bb_mirror_horizontal(b);
+    return b;
+}
+
+// Image of square `sq` under `symmetry`, same as symmetry_transform of its bit
+static inline int symmetry_square(int sq, int symmetry)
+{
+    int row = sq >> 3, column = sq & 7;
+    if (symmetry & 4)
+    {
+        int swap = row;
+        row = column;
+        column = swap;
+    }
+    if (symmetry & 2)
+        row = 7 - row;
+    if (symmetry & 1)
+        column = 7 - column;
+    return row * 8 + column;
+}
+
+// The square whose image under `symmetry` is `sq`
+static inline int symmetry_inverse_square(int sq, int symmetry)
+{
+    int row = sq >> 3, column = sq & 7;
+    if (symmetry & 1)
+        column = 7 - column;
+    if (symmetry & 2)
+        row = 7 - row;
+    if (symmetry & 4)
+        return column * 8 + row;
+    return row * 8 + column;
+}
+
+// Write the canonical form of the disks `own` and `opp` into `canonical` and return the symmetry that gives it
+static inline int symmetry_canonical(ull own, ull opp, ull canonical[2])
+{
+    int best = 0;
+    canonical[0] = own;
+    canonical[1] = opp;
+    for (int symmetry = 1; symmetry < SYMMETRY_COUNT; symmetry++)
+    {
+        ull own_image = symmetry_transform(own, symmetry);
+        if (own_image > canonical[0])
+            continue;
+        ull opp_image = symmetry_transform(opp, symmetry);
+        if (own_image < canonical[0] || opp_image < canonical[1])
+        {
+            best = symmetry;
+            canonical[0] = own_image;
+            canonical[1] = opp_image;
+        }
+    }
+    return best;
+}
+
+// Zobrist hash of the canonical form of the position, with `color` to move; `symmetry` receives the symmetry to it
+static inline ull symmetry_key(ull own, ull opp, int color, int *symmetry)
+{
+    ull canonical[2];
+    *symmetry = symmetry_canonical(own, opp, canonical);
+    ull disks[2];
+    disks[color] = canonical[0];
+    disks[1 - color] = canonical[1];
+    return zobrist_hash(disks, color);
+}
+
+/*
+return the moves of `moves` left after dropping every move that is the image of
+a kept one under a symmetry of the position; all moves if it has none.
+*/
+static inline ull symmetry_unique_moves(ull own, ull opp, ull moves)
+{
+    int symmetries[SYMMETRY_COUNT];
+    int nsymmetries = 0;
+    for (int symmetry = 1; symmetry < SYMMETRY_COUNT; symmetry++)
+        if (symmetry_transform(own, symmetry) == own && symmetry_transform(opp, symmetry) == opp)
+            symmetries[nsymmetries++] = symmetry;
+    if (nsymmetries == 0)
+        return moves;
+
+    ull unique = 0;
+    for (; moves; moves &= moves - 1)
+    {
+        int sq = bb_first_square(moves);
+        bool image = false;
+        for (int i = 0; i < nsymmetries && !image; i++)
+            image = (unique & BB_SQUARE_BIT(symmetry_square(sq, symmetries[i]))) != 0;
+        if (!image)
+            unique |= BB_SQUARE_BIT(sq);
+    }
+    return unique;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+/*
+fixed-size transposition table shared by every search worker.
+
+positions are keyed by a Zobrist hash: one random 64-bit key per (color, square)
+plus one key for the side to move, xor-ed together.
+
+the table is lockless. each entry is two 64-bit words, the packed data and
+the key xor-ed with that data. a reader recomputes key ^ data and only trusts
+the entry if it matches, so an entry torn by two workers storing at the same
+time reads as a miss instead of returning another position's score.
+
+entries are grouped in buckets of two: the first slot keeps the deepest search
+seen for that bucket, the second slot is always replaced.
+
+the table is kept from one move of a game to the next: tt_new_search() starts a
+new generation instead of clearing it, and every entry records the generation
+that stored it. an entry from an earlier move still answers probes, but it holds
+the first slot only as long as it is deeper than a new search by
+TT_AGE_DEPTH moves per generation, so stale entries give way to the current search.
+*/
+
+typedef unsigned long long ull;
+
+#define TT_EXACT 0
+#define TT_LOWER 1 /* score is a lower bound (the search failed high) */
+#define TT_UPPER 2 /* score is an upper bound (the search failed low) */
+
+#define TT_NO_MOVE 64
+#define TT_DEFAULT_MEGABYTES 16
+
+/* nodes with fewer moves left are cheaper to search again than to hash */
+#define TT_MIN_DEPTH 2
+
+/* depth an entry loses per generation when competing for the depth-preferred slot: two plies per move of a game */
+#define TT_AGE_DEPTH 2
+
+typedef struct
+{
+    ull squares[2][64];
+    ull flips[64]; /* squares[0][sq] ^ squares[1][sq]: the disk on sq changes color */
+    ull side;
+} ZobristKeys;
+
+// Shared with the engine library like bb_kernel (bitboard_simd.h)
+#ifdef ENGINE_LIBRARY
+extern ZobristKeys zobrist;
+#define TT_ZOBRIST_SHARED
+#else
+static ZobristKeys zobrist;
+#endif
+
+// splitmix64: a fixed seed gives the same keys in every run
+static inline ull zobrist_next(ull *state)
+{
+    ull z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline void zobrist_init()
+{
+    ull state = 0x4f7468656c6c6fULL;
+    for (int color = 0; color < 2; color++)
+        for (int sq = 0; sq < 64; sq++)
+            zobrist.squares[color][sq] = zobrist_next(&state);
+    zobrist.side = zobrist_next(&state);
+    for (int sq = 0; sq < 64; sq++)
+        zobrist.flips[sq] = zobrist.squares[0][sq] ^ zobrist.squares[1][sq];
+}
+
+// Hash of the disks of both colors with `color` to move
+static inline ull zobrist_hash(const ull disks[2], int color)
+{
+    ull key = color ? zobrist.side : 0;
+    for (int c = 0; c < 2; c++)
+        for (ull bits = disks[c]; bits; bits &= bits - 1)
+            key ^= zobrist.squares[c][__builtin_ctzll(bits)];
+    return key;
+}
+
+typedef struct
+{
+    int depth;
+    int bound;
+    int score;
+    int move; /* square index as in bitboard.h, TT_NO_MOVE if none */
+} TTResult;
+
+typedef struct
+{
+    std::atomic<ull> check; /* key ^ data */
+    std::atomic<ull> data;
+} TTEntry;
+
+typedef struct
+{
+    TTEntry *entries;
+    ull bucket_mask;     /* number of buckets - 1 */
+    unsigned generation; /* of the current search, 8 bits */
+} TranspositionTable;
+
+/*
+data layout, low to high bits:
+    score + 32768 (16 bits) | depth (8 bits) | bound (2 bits) | move (7 bits) | generation (8 bits)
+stored depths are at least 1, so a cleared (all zero) entry never verifies.
+*/
+static inline ull tt_pack(int depth, int bound, int score, int move, unsigned generation)
+{
+    return (ull)(score + 32768) | ((ull)depth << 16) | ((ull)bound << 24) | ((ull)move << 26) | ((ull)generation << 33);
+}
+
+static inline void tt_unpack(ull data, TTResult *result)
+{
+    result->score = (int)(data & 0xffff) - 32768;
+    result->depth = (int)((data >> 16) & 0xff);
+    result->bound = (int)((data >> 24) & 0x3);
+    result->move = (int)((data >> 26) & 0x7f);
+}
+
+static inline void tt_clear(TranspositionTable *tt)
+{
+    if (tt->entries)
+        memset((void *)tt->entries, 0, (tt->bucket_mask + 1) * 2 * sizeof(TTEntry));
+    tt->generation = 0;
+}
+
+// Start the search of the next move: the entries of earlier searches age instead of being cleared
+static inline void tt_new_search(TranspositionTable *tt)
+{
+    tt->generation = (tt->generation + 1) & 0xff;
+}
+
+/* allocate the largest power-of-two number of buckets that fits in `megabytes`; 0 disables the table */
+static inline void tt_init(TranspositionTable *tt, size_t megabytes)
+{
+    size_t buckets = 1;
+    free(tt->entries);
+    tt->entries = NULL;
+    tt->bucket_mask = 0;
+    if (megabytes == 0)
+        return;
+    while (buckets * 2 * 2 * sizeof(TTEntry) <= megabytes << 20)
+        buckets *= 2;
+    tt->entries = (TTEntry *)malloc(buckets * 2 * sizeof(TTEntry));
+    if (tt->entries == NULL)
+    {
+        fprintf(stderr, "cannot allocate a %zu MB transposition table\n", megabytes);
+        exit(1);
+    }
+    tt->bucket_mask = buckets - 1;
+    tt_clear(tt);
+}
+
+static inline bool tt_probe(const TranspositionTable *tt, ull key, TTResult *result)
+{
+    if (tt->entries == NULL)
+        return false;
+    TTEntry *bucket = &tt->entries[(key & tt->bucket_mask) * 2];
+    for (int i = 0; i < 2; i++)
+    {
+        ull data = bucket[i].data.load(std::memory_order_relaxed);
+        ull check = bucket[i].check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && data != 0)
+        {
+            tt_unpack(data, result);
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void tt_store(TranspositionTable *tt, ull key, int depth, int bound, int score, int move)
+{
+    if (tt->entries == NULL)
+        return;
+    TTEntry *bucket = &tt->entries[(key & tt->bucket_mask) * 2];
+    ull data = tt_pack(depth, bound, score, move, tt->generation);
+
+    // depth-preferred slot: take it for the same position or an equal or deeper search, counting the age of the old entry against it
+    ull old_data = bucket[0].data.load(std::memory_order_relaxed);
+    ull old_key = bucket[0].check.load(std::memory_order_relaxed) ^ old_data;
+    int old_age = (int)((tt->generation - (unsigned)(old_data >> 33)) & 0xff);
+    TTEntry *slot = &bucket[1];
+    if (old_key == key || depth + TT_AGE_DEPTH * old_age >= (int)((old_data >> 16) & 0xff))
+        slot = &bucket[0];
+
+    slot->data.store(data, std::memory_order_relaxed);
+    slot->check.store(key ^ data, std::memory_order_relaxed);
+}
+
+#endif